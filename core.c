@@ -28,46 +28,94 @@ int mt7601u_wait_asic_ready(struct mt7601u_dev *dev)
 	return -EIO;
 }
 
-bool mt76_poll(struct mt7601u_dev *dev, u32 offset, u32 mask, u32 val,
-	       int timeout)
+static void
+mt76_poll_account(struct mt7601u_dev *dev, unsigned long caller, u32 offset,
+		  u32 reads, u32 wait_us, bool timeout)
 {
-	u32 cur;
+	struct mt7601u_poll_stat *st = NULL;
+	int i;
+
+	spin_lock_bh(&dev->poll_lock);
+	for (i = 0; i < ARRAY_SIZE(dev->poll_stats); i++)
+		if (dev->poll_stats[i].caller == caller ||
+		    !dev->poll_stats[i].caller) {
+			st = &dev->poll_stats[i];
+			break;
+		}
+
+	/* Table full, lump the rest together */
+	if (!st) {
+		st = &dev->poll_stats_other;
+	} else {
+		st->caller = caller;
+		st->offset = offset;
+	}
+
+	st->calls++;
+	st->reads += reads;
+	st->wait_us += wait_us;
+	st->max_us = max(st->max_us, wait_us);
+	st->timeouts += timeout;
+	spin_unlock_bh(&dev->poll_lock);
+}
 
-	timeout /= 10;
-	do {
-		cur = mt76_rr(dev, offset) & mask;
-		if (cur == val)
-			return true;
+/* Poll the register sleeping between reads, starting with a short sleep
+ * and doubling it on every miss up to @max_delay.  Gives up after both
+ * @timeout us passed and @min_reads reads were done.
+ */
+static bool
+__mt76_poll(struct mt7601u_dev *dev, u32 offset, u32 mask, u32 val,
+	    u32 timeout, u32 min_reads, u32 max_delay, unsigned long caller)
+{
+	ktime_t start = ktime_get();
+	u32 delay = MT_POLL_MIN_DELAY_US;
+	u32 reads = 0;
+	bool ret = false;
+	s64 elapsed;
+
+	might_sleep();
+
+	while (true) {
+		reads++;
+		if ((mt76_rr(dev, offset) & mask) == val) {
+			ret = true;
+			break;
+		}
 
 		if (test_bit(MT7601U_STATE_REMOVED, &dev->state))
-			return false;
+			break;
+
+		elapsed = ktime_us_delta(ktime_get(), start);
+		if (elapsed >= timeout && reads > min_reads) {
+			printk("Error: Time out with reg %08x\n", offset);
+			break;
+		}
 
-		udelay(10);
-	} while (timeout-- > 0);
+		usleep_range(delay, delay * 2);
+		delay = min(delay * 2, max_delay);
+	}
 
-	printk("Error: Time out with reg %08x\n", offset);
+	mt76_poll_account(dev, caller, offset, reads,
+			  ktime_us_delta(ktime_get(), start), !ret);
+
+	return ret;
+}
 
-	return false;
+/* Note: timeout used to be counted in 10us busy-wait steps, each of which
+ *	 also did a USB read taking a few hundred us, so short timeouts were
+ *	 in practice much longer.  Keep doing a minimum number of reads.
+ */
+bool mt76_poll(struct mt7601u_dev *dev, u32 offset, u32 mask, u32 val,
+	       int timeout)
+{
+	return __mt76_poll(dev, offset, mask, val, timeout,
+			   min(timeout / 10, MT_POLL_MIN_READS),
+			   MT_POLL_MAX_DELAY_US, _RET_IP_);
 }
 
 bool mt76_poll_msec(struct mt7601u_dev *dev, u32 offset, u32 mask, u32 val,
 		    int timeout)
 {
-	u32 cur;
-
-	timeout /= 10;
-	do {
-		cur = mt76_rr(dev, offset) & mask;
-		if (cur == val)
-			return true;
-
-		if (test_bit(MT7601U_STATE_REMOVED, &dev->state))
-			return false;
-
-		msleep(10);
-	} while (timeout-- > 0);
-
-	printk("Error: Time out with reg %08x\n", offset);
-
-	return false;
+	return __mt76_poll(dev, offset, mask, val, timeout * USEC_PER_MSEC,
+			   0, MT_POLL_MAX_DELAY_MSEC_US, _RET_IP_);
 }
@@ -36,6 +36,37 @@ mt76_reg_get(void *data, u64 *val)
 
 DEFINE_SIMPLE_ATTRIBUTE(fops_regval, mt76_reg_get, mt76_reg_set, "0x%08llx\n");
 
+/* Note: PKT_IDs of frames in flight are only meaningful in the mode they
+ *	 were sent in, so the mode can only change while the device is down
+ *	 (mt7601u_mac_stop() waits for TX and the last status poll).
+ */
+static int
+mt7601u_tx_stat_ext_set(void *data, u64 val)
+{
+	struct mt7601u_dev *dev = data;
+	int ret = 0;
+
+	mutex_lock(&dev->mutex);
+	if (test_bit(MT7601U_STATE_WLAN_RUNNING, &dev->state))
+		ret = -EBUSY;
+	else
+		dev->tx_stat_ext = !!val;
+	mutex_unlock(&dev->mutex);
+
+	return ret;
+}
+
+static int
+mt7601u_tx_stat_ext_get(void *data, u64 *val)
+{
+	struct mt7601u_dev *dev = data;
+
+	*val = dev->tx_stat_ext;
+	return 0;
+}
+
+DEFINE_SIMPLE_ATTRIBUTE(fops_tx_stat_ext, mt7601u_tx_stat_ext_get,
+			mt7601u_tx_stat_ext_set, "%llu\n");
 
 static int
 mt76_ampdu_stat_read(struct seq_file *file, void *data)
@@ -73,8 +104,20 @@ mt76_ampdu_stat_read(struct seq_file *file, void *data)
 		seq_putc(file, '\n');
 	}
 
-	seq_printf(file, "recent average AMPDU len: %d\n",
-		   atomic_read(&dev->avg_ampdu_len));
+	seq_printf(file, "stats read time: %uus\n", dev->stats.work_us);
+
+	rcu_read_lock();
+	for (i = 0; i < ARRAY_SIZE(dev->wcid); i++) {
+		struct mt76_wcid *wcid = rcu_dereference(dev->wcid[i]);
+
+		if (!wcid || !wcid->ampdu_len_avg)
+			continue;
+
+		seq_printf(file, "wcid %d average AMPDU len: %d.%02d\n", i,
+			   wcid->ampdu_len_avg / 16,
+			   (wcid->ampdu_len_avg % 16) * 100 / 16);
+	}
+	rcu_read_unlock();
 
 	return 0;
 }
@@ -92,6 +135,586 @@ static const struct file_operations fops_ampdu_stat = {
 	.release = single_release,
 };
 
+static int
+mt7601u_tx_stat_read(struct seq_file *file, void *data)
+{
+	struct mt7601u_dev *dev = file->private;
+	struct mt7601u_txs_stats *st = &dev->txs_stats;
+	u32 spp;
+
+	spp = st->polls ? div64_u64(st->statuses * 100, st->polls) : 0;
+
+	seq_printf(file, "mode:\t\t%s\n",
+		   dev->tx_stat_batch ? "MCU batch" : "single read");
+	seq_printf(file, "polls:\t\t%llu\n", st->polls);
+	seq_printf(file, "empty polls:\t%llu\n", st->empty_polls);
+	seq_printf(file, "early kicks:\t%llu\n", st->kicks);
+	seq_printf(file, "statuses:\t%llu\n", st->statuses);
+	seq_printf(file, "statuses/poll:\t%u.%02u\n", spp / 100, spp % 100);
+	seq_printf(file, "poll delay:\t%uus\n", dev->tx_stat_delay);
+	seq_printf(file, "pending:\t%u\n", dev->tx_stat_pending);
+	seq_printf(file, "HT fallback:\t%08x\n", dev->ht_fbk);
+	seq_printf(file, "usb xfers:\t%llu\n", st->usb_xfers);
+	seq_printf(file, "batch errors:\t%llu\n", st->batch_errors);
+	seq_printf(file, "FIFO full:\t%llu\n", st->fifo_full);
+	seq_printf(file, "lost:\t\t%llu\n", st->lost);
+	seq_printf(file, "drain time:\t%lluus\n", st->drain_us);
+	seq_printf(file, "statuses/s:\t%llu\n", st->drain_us ?
+		   div64_u64(st->statuses * USEC_PER_SEC, st->drain_us) : 0);
+
+	seq_printf(file, "EXT_FIFO:\t%s\n", dev->tx_stat_ext ? "on" : "off");
+	seq_printf(file, "\tstatuses:\t%llu\n", st->ext_statuses);
+	seq_printf(file, "\tstale pktid:\t%llu\n", st->pktid_stale);
+	seq_printf(file, "\tretries:\t%llu (pktid guess %llu)\n",
+		   st->ext_retries, st->pktid_retries);
+	seq_printf(file, "\tmatch:\t\t%llu\n", st->retry_match);
+	seq_printf(file, "\text more:\t%llu\n", st->retry_ext_more);
+	seq_printf(file, "\text less:\t%llu\n", st->retry_ext_less);
+
+	return 0;
+}
+
+static int
+mt7601u_tx_stat_open(struct inode *inode, struct file *f)
+{
+	return single_open(f, mt7601u_tx_stat_read, inode->i_private);
+}
+
+static const struct file_operations fops_tx_stat = {
+	.open = mt7601u_tx_stat_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int
+mt7601u_reg_cache_read(struct seq_file *file, void *data)
+{
+	struct mt7601u_dev *dev = file->private;
+	struct mt7601u_reg_cache_stats st;
+	u32 rate;
+	int valid;
+
+	spin_lock_bh(&dev->reg_cache_lock);
+	st = dev->reg_cache_stats;
+	valid = bitmap_weight(dev->reg_cache_valid, MT_REG_CACHE_SIZE);
+	spin_unlock_bh(&dev->reg_cache_lock);
+
+	rate = st.reads ? div64_u64(st.hits * 1000, st.reads) : 0;
+
+	seq_printf(file, "enabled:\t%s\n", dev->reg_cache_en ? "yes" : "no");
+	seq_printf(file, "valid:\t\t%d/%d\n", valid, MT_REG_CACHE_SIZE);
+	seq_printf(file, "reads:\t\t%llu\n", st.reads);
+	seq_printf(file, "hits:\t\t%llu (%u.%u%%)\n", st.hits,
+		   rate / 10, rate % 10);
+	seq_printf(file, "writes:\t\t%llu\n", st.writes);
+	seq_printf(file, "skipped writes:\t%llu\n", st.skipped);
+	seq_printf(file, "resyncs:\t%llu\n", st.resyncs);
+	seq_printf(file, "stale fills:\t%llu\n", st.stale);
+
+	spin_lock_bh(&dev->reg_cache_lock);
+	st = dev->bbp_cache_stats;
+	valid = bitmap_weight(dev->bbp_cache_valid, MT_BBP_CACHE_SIZE);
+	spin_unlock_bh(&dev->reg_cache_lock);
+
+	rate = st.reads ? div64_u64(st.hits * 1000, st.reads) : 0;
+
+	seq_printf(file, "BBP valid:\t%d/%d\n", valid, MT_BBP_CACHE_SIZE);
+	seq_printf(file, "BBP reads:\t%llu\n", st.reads);
+	seq_printf(file, "BBP hits:\t%llu (%u.%u%%)\n", st.hits,
+		   rate / 10, rate % 10);
+	seq_printf(file, "BBP writes:\t%llu\n", st.writes);
+	seq_printf(file, "BBP resyncs:\t%llu\n", st.resyncs);
+
+	seq_printf(file, "usb ctrl xfers:\t%llu\n", dev->vend_reqs);
+	seq_printf(file, "reg writes:\t%llu (%s)\n", dev->vend_wrs,
+		   dev->vend_multi_wr ? "single xfer" : "split");
+
+	return 0;
+}
+
+static int
+mt7601u_reg_cache_open(struct inode *inode, struct file *f)
+{
+	return single_open(f, mt7601u_reg_cache_read, inode->i_private);
+}
+
+static const struct file_operations fops_reg_cache = {
+	.open = mt7601u_reg_cache_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int
+mt7601u_posted_wr_read(struct seq_file *file, void *data)
+{
+	struct mt7601u_dev *dev = file->private;
+	struct mt7601u_posted_stats st;
+	unsigned long flags;
+
+	spin_lock_irqsave(&dev->posted_lock, flags);
+	st = dev->posted_stats;
+	spin_unlock_irqrestore(&dev->posted_lock, flags);
+
+	seq_printf(file, "posted:\t\t%llu\n", st.posted);
+	seq_printf(file, "flushes:\t%llu\n", st.flushes);
+	seq_printf(file, "errors:\t\t%llu\n", st.errors);
+	seq_printf(file, "replayed:\t%llu\n", st.replayed);
+	seq_printf(file, "avg latency:\t%lluus\n",
+		   st.posted ? div64_u64(st.lat_total_us, st.posted) : 0);
+	seq_printf(file, "max latency:\t%uus\n", st.lat_max_us);
+
+	return 0;
+}
+
+static int
+mt7601u_posted_wr_open(struct inode *inode, struct file *f)
+{
+	return single_open(f, mt7601u_posted_wr_read, inode->i_private);
+}
+
+static const struct file_operations fops_posted_wr = {
+	.open = mt7601u_posted_wr_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int
+mt7601u_poll_stat_read(struct seq_file *file, void *data)
+{
+	struct mt7601u_dev *dev = file->private;
+	struct mt7601u_poll_stat *st;
+	int i;
+
+	seq_puts(file, "reg\tcalls\treads\ttimeout\twait us\tmax us\tcaller\n");
+
+	spin_lock_bh(&dev->poll_lock);
+	for (i = 0; i < ARRAY_SIZE(dev->poll_stats); i++) {
+		st = &dev->poll_stats[i];
+		if (!st->caller)
+			break;
+
+		seq_printf(file, "%04x\t%u\t%llu\t%u\t%llu\t%u\t%pS\n",
+			   st->offset, st->calls, st->reads, st->timeouts,
+			   st->wait_us, st->max_us, (void *)st->caller);
+	}
+
+	st = &dev->poll_stats_other;
+	if (st->calls)
+		seq_printf(file, "-\t%u\t%llu\t%u\t%llu\t%u\tother\n",
+			   st->calls, st->reads, st->timeouts,
+			   st->wait_us, st->max_us);
+	spin_unlock_bh(&dev->poll_lock);
+
+	return 0;
+}
+
+static int
+mt7601u_poll_stat_open(struct inode *inode, struct file *f)
+{
+	return single_open(f, mt7601u_poll_stat_read, inode->i_private);
+}
+
+static const struct file_operations fops_poll_stat = {
+	.open = mt7601u_poll_stat_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static void mt7601u_usb_hist_print(struct seq_file *file, const u32 *hist)
+{
+	int i;
+
+	for (i = 0; i < MT_USB_HIST_BUCKETS; i++)
+		seq_printf(file, " %u", hist[i]);
+	seq_putc(file, '\n');
+}
+
+static int
+mt7601u_usb_stats_read(struct seq_file *file, void *data)
+{
+	static const char * const names[__MT_VEND_TYPE_MAX] = {
+		[MT_VEND_TYPE_READ] = "read",
+		[MT_VEND_TYPE_WRITE] = "write",
+		[MT_VEND_TYPE_FCE] = "fce write",
+		[MT_VEND_TYPE_DEV_MODE] = "dev mode",
+		[MT_VEND_TYPE_OTHER] = "other",
+	};
+	static const char * const prio_names[__MT_IO_PRIO_MAX] = {
+		[MT_IO_PRIO_DATAPATH] = "datapath",
+		[MT_IO_PRIO_NORMAL] = "normal",
+		[MT_IO_PRIO_BULK] = "bulk",
+	};
+	struct mt7601u_dev *dev = file->private;
+	struct mt7601u_usb_stats *st;
+	int i;
+
+	st = kmalloc(sizeof(*st), GFP_KERNEL);
+	if (!st)
+		return -ENOMEM;
+
+	mutex_lock(&dev->vendor_req_mutex);
+	*st = dev->usb_stats;
+	mutex_unlock(&dev->vendor_req_mutex);
+
+	seq_puts(file, "Latency histograms, bucket n is [2^(n-1), 2^n) us:\n");
+	for (i = 0; i < __MT_VEND_TYPE_MAX; i++) {
+		seq_printf(file, "%s (%llu):", names[i], st->reqs[i]);
+		mt7601u_usb_hist_print(file, st->lat[i]);
+	}
+	seq_puts(file, "lock wait:");
+	mt7601u_usb_hist_print(file, st->lock_wait);
+	seq_printf(file, "lock wait total: %lluus\n", st->lock_wait_us);
+
+	seq_puts(file, "Queueing delay per class (reqs/total us/max us):\n");
+	for (i = 0; i < __MT_IO_PRIO_MAX; i++)
+		seq_printf(file, "%s: %llu %llu %u\n", prio_names[i],
+			   st->prio_reqs[i], st->prio_wait_us[i],
+			   st->prio_max_us[i]);
+
+	seq_puts(file, "Retries:");
+	for (i = 0; i < ARRAY_SIZE(st->retries); i++)
+		seq_printf(file, " %u", st->retries[i]);
+	seq_putc(file, '\n');
+	seq_printf(file, "Timeouts: %u\n", st->timeouts);
+	seq_printf(file, "Failures: %u\n", st->failures);
+	seq_printf(file, "Breaker: %s, fail streak %u/%u\n",
+		   dev->vend_breaker_open ? "open" : "closed",
+		   dev->vend_fail_streak, dev->vend_breaker_thresh);
+	seq_printf(file, "Breaker trips: %u rejected: %u\n",
+		   st->breaker_trips, st->rejected);
+
+	kfree(st);
+
+	return 0;
+}
+
+static int
+mt7601u_usb_stats_open(struct inode *inode, struct file *f)
+{
+	return single_open(f, mt7601u_usb_stats_read, inode->i_private);
+}
+
+/* Any write resets the stats */
+static ssize_t
+mt7601u_usb_stats_write(struct file *f, const char __user *buf, size_t count,
+			loff_t *ppos)
+{
+	struct seq_file *file = f->private_data;
+	struct mt7601u_dev *dev = file->private;
+
+	mutex_lock(&dev->vendor_req_mutex);
+	memset(&dev->usb_stats, 0, sizeof(dev->usb_stats));
+	mutex_unlock(&dev->vendor_req_mutex);
+
+	return count;
+}
+
+static const struct file_operations fops_usb_stats = {
+	.open = mt7601u_usb_stats_open,
+	.read = seq_read,
+	.write = mt7601u_usb_stats_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int
+mt7601u_wr_batch_read(struct seq_file *file, void *data)
+{
+	struct mt7601u_dev *dev = file->private;
+	struct mt7601u_wr_batch_stat *st;
+	u64 direct;
+	int i;
+
+	seq_puts(file, "commits\twrites\txfers\tsaved\tcaller\n");
+
+	for (i = 0; i < ARRAY_SIZE(dev->wr_batch_stats); i++) {
+		st = &dev->wr_batch_stats[i];
+		if (!st->caller)
+			break;
+
+		/* Without multi-write each register takes two control xfers */
+		direct = st->writes * (dev->vend_multi_wr ? 1 : 2);
+
+		seq_printf(file, "%u\t%llu\t%llu\t%lld\t%pS\n",
+			   st->commits, st->writes, st->xfers,
+			   (s64)(direct - st->xfers), (void *)st->caller);
+	}
+
+	return 0;
+}
+
+static int
+mt7601u_wr_batch_open(struct inode *inode, struct file *f)
+{
+	return single_open(f, mt7601u_wr_batch_read, inode->i_private);
+}
+
+static const struct file_operations fops_wr_batch = {
+	.open = mt7601u_wr_batch_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int
+mt7601u_mcu_stat_read(struct seq_file *file, void *data)
+{
+	struct mt7601u_dev *dev = file->private;
+	struct mt7601u_mcu_stats *st = &dev->mcu.stats;
+	int i;
+
+	seq_printf(file, "commands:\t%llu\n", st->cmds);
+	seq_printf(file, "async:\t\t%llu\n", st->async);
+	seq_printf(file, "in flight:\t%d (max %u, window %d)\n",
+		   READ_ONCE(dev->mcu.inflight), st->max_inflight,
+		   MT_MCU_MAX_INFLIGHT);
+	seq_printf(file, "window full:\t%u\n", st->window_full);
+	seq_printf(file, "timeouts:\t%u\n", st->timeouts);
+	seq_printf(file, "late resps:\t%u\n", st->late_resps);
+	seq_printf(file, "phy init:\t%uus, %u commands\n",
+		   st->phy_init_us, st->phy_init_cmds);
+	seq_printf(file, "fw upload:\t%uus, %u chunks, boot %uus\n",
+		   st->fw_upload_us, st->fw_chunks, st->fw_boot_us);
+
+	/* Each command used to allocate an skb and an URB */
+	seq_printf(file, "cmd bufs:\t%llu reused, %u waits\n",
+		   st->buf_gets, st->buf_waits);
+	seq_printf(file, "allocs avoided:\tinit %u, last cal cycle %u\n",
+		   st->init_buf_gets * 2, st->cal_buf_gets * 2);
+	seq_printf(file, "rmw regs:\t%llu\n", st->rmw_regs);
+	seq_printf(file, "resp posted:\t%d (starved %u)\n",
+		   atomic_read(&dev->mcu.resp_posted), st->resp_starved);
+	seq_puts(file, "resp evts:\t");
+	for (i = 0; i < MT_MCU_EVT_MAX; i++)
+		seq_printf(file, " %u", st->evts[i]);
+	seq_putc(file, '\n');
+
+	return 0;
+}
+
+static int
+mt7601u_mcu_stat_open(struct inode *inode, struct file *f)
+{
+	return single_open(f, mt7601u_mcu_stat_read, inode->i_private);
+}
+
+static const struct file_operations fops_mcu_stat = {
+	.open = mt7601u_mcu_stat_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int
+mt7601u_xfers_read(struct seq_file *file, void *data)
+{
+	static const char * const names[__MT_XFER_MAX] = {
+		[MT_XFER_CHAN_SWITCH] = "chan switch",
+		[MT_XFER_TEMP_COMP] = "temp comp",
+		[MT_XFER_FREQ_CAL] = "freq cal",
+	};
+	struct mt7601u_dev *dev = file->private;
+	int i;
+
+	seq_printf(file, "MCU rmw:\t%s\n", dev->mcu_rmw ? "on" : "off");
+	seq_printf(file, "MCU RF:\t\t%s\n", dev->rf_mcu ? "on" : "off");
+	for (i = 0; i < __MT_XFER_MAX; i++) {
+		struct mt7601u_xfer_stat *st = &dev->xfer_stats[i];
+
+		seq_printf(file, "%s:\tlast %u avg %llu (%u runs)\n", names[i],
+			   st->last,
+			   st->runs ? div_u64(st->total, st->runs) : 0,
+			   st->runs);
+		seq_printf(file, "\t\tlast %uus avg %lluus\n", st->last_us,
+			   st->runs ? div_u64(st->total_us, st->runs) : 0);
+	}
+
+	return 0;
+}
+
+/* Any write resets the stats, e.g. before toggling mcu_rmw or rf_mcu */
+static ssize_t
+mt7601u_xfers_write(struct file *f, const char __user *buf, size_t count,
+		    loff_t *ppos)
+{
+	struct seq_file *file = f->private_data;
+	struct mt7601u_dev *dev = file->private;
+
+	memset(dev->xfer_stats, 0, sizeof(dev->xfer_stats));
+
+	return count;
+}
+
+static int
+mt7601u_xfers_open(struct inode *inode, struct file *f)
+{
+	return single_open(f, mt7601u_xfers_read, inode->i_private);
+}
+
+static const struct file_operations fops_xfers = {
+	.open = mt7601u_xfers_open,
+	.read = seq_read,
+	.write = mt7601u_xfers_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int
+mt7601u_cal_cache_read(struct seq_file *file, void *data)
+{
+	struct mt7601u_dev *dev = file->private;
+	struct mt7601u_cal_cache_stats *st = &dev->cal_cache_stats;
+
+	seq_printf(file, "hits:\t\t%u\n", st->hits);
+	seq_printf(file, "misses:\t\t%u\n", st->misses);
+	seq_printf(file, "last full cal:\t%uus\n", st->cal_us);
+	seq_printf(file, "time saved:\t%lluus\n", st->saved_us);
+
+	return 0;
+}
+
+/* Any write drops cached results for this device */
+static ssize_t
+mt7601u_cal_cache_write(struct file *f, const char __user *buf, size_t count,
+			loff_t *ppos)
+{
+	struct seq_file *file = f->private_data;
+	struct mt7601u_dev *dev = file->private;
+
+	mt7601u_cal_cache_flush(dev);
+
+	return count;
+}
+
+static int
+mt7601u_cal_cache_open(struct inode *inode, struct file *f)
+{
+	return single_open(f, mt7601u_cal_cache_read, inode->i_private);
+}
+
+static const struct file_operations fops_cal_cache = {
+	.open = mt7601u_cal_cache_open,
+	.read = seq_read,
+	.write = mt7601u_cal_cache_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int
+mt7601u_read_bench_read(struct seq_file *file, void *data)
+{
+	static const char * const names[__MT_RD_MAX] = {
+		[MT_RD_SINGLE] = "single",
+		[MT_RD_VEND_BULK] = "vendor bulk",
+		[MT_RD_MCU_RANDOM] = "MCU random",
+		[MT_RD_MCU_BURST] = "MCU burst",
+	};
+	struct mt7601u_dev *dev = file->private;
+	struct mt7601u_rd_bench *bench = &dev->rd_bench;
+	int i;
+
+	seq_printf(file, "regs:\t\t%d\n", bench->n);
+	for (i = 0; i < __MT_RD_MAX; i++)
+		seq_printf(file, "%s:\t%uus\n", names[i], bench->us[i]);
+	seq_printf(file, "MCU burst min:\t%hu\n", dev->rd_burst_min);
+
+	return 0;
+}
+
+static int
+mt7601u_read_bench_open(struct inode *inode, struct file *f)
+{
+	return single_open(f, mt7601u_read_bench_read, inode->i_private);
+}
+
+/* Write number of registers to run the benchmark */
+static ssize_t
+mt7601u_read_bench_write(struct file *f, const char __user *buf,
+			 size_t count, loff_t *ppos)
+{
+	struct seq_file *file = f->private_data;
+	struct mt7601u_dev *dev = file->private;
+	int n, ret;
+
+	ret = kstrtoint_from_user(buf, count, 0, &n);
+	if (ret)
+		return ret;
+
+	ret = mt7601u_rr_bench(dev, n);
+	if (ret)
+		return ret;
+
+	return count;
+}
+
+static const struct file_operations fops_read_bench = {
+	.open = mt7601u_read_bench_open,
+	.read = seq_read,
+	.write = mt7601u_read_bench_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int
+mt7601u_write_bench_read(struct seq_file *file, void *data)
+{
+	static const char * const names[__MT_WR_MAX] = {
+		[MT_WR_SPLIT] = "split 16-bit",
+		[MT_WR_MULTI] = "multi-write",
+	};
+	struct mt7601u_dev *dev = file->private;
+	struct mt7601u_wr_bench *bench = &dev->wr_bench;
+	int i;
+
+	seq_printf(file, "regs:\t\t%d\n", bench->n);
+	for (i = 0; i < __MT_WR_MAX; i++)
+		seq_printf(file, "%s:\t%u xfers, %uus\n", names[i],
+			   bench->xfers[i], bench->us[i]);
+	seq_printf(file, "HW init (%s):\t%llu xfers, %llu writes, %uus\n",
+		   names[dev->vend_multi_wr ? MT_WR_MULTI : MT_WR_SPLIT],
+		   bench->init_xfers, bench->init_wrs, bench->init_us);
+
+	return 0;
+}
+
+static int
+mt7601u_write_bench_open(struct inode *inode, struct file *f)
+{
+	return single_open(f, mt7601u_write_bench_read, inode->i_private);
+}
+
+/* Write number of registers to run the benchmark */
+static ssize_t
+mt7601u_write_bench_write(struct file *f, const char __user *buf,
+			  size_t count, loff_t *ppos)
+{
+	struct seq_file *file = f->private_data;
+	struct mt7601u_dev *dev = file->private;
+	int n, ret;
+
+	ret = kstrtoint_from_user(buf, count, 0, &n);
+	if (ret)
+		return ret;
+
+	ret = mt7601u_wr_bench(dev, n);
+	if (ret)
+		return ret;
+
+	return count;
+}
+
+static const struct file_operations fops_write_bench = {
+	.open = mt7601u_write_bench_open,
+	.read = seq_read,
+	.write = mt7601u_write_bench_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 static int
 mt7601u_eeprom_param_read(struct seq_file *file, void *data)
 {
@@ -165,4 +788,33 @@ void mt7601u_init_debugfs(struct mt7601u_dev *dev)
 	debugfs_create_file("ampdu_stat", S_IRUSR, dir, dev, &fops_ampdu_stat);
 	debugfs_create_file("eeprom_param", S_IRUSR, dir, dev,
 			    &fops_eeprom_param);
+
+	debugfs_create_u8("tx_stat_batch", S_IRUSR | S_IWUSR, dir,
+			  &dev->tx_stat_batch);
+	debugfs_create_file("tx_stat_ext", S_IRUSR | S_IWUSR, dir, dev,
+			    &fops_tx_stat_ext);
+	debugfs_create_file("tx_stat", S_IRUSR, dir, dev, &fops_tx_stat);
+
+	debugfs_create_u8("reg_cache_en", S_IRUSR | S_IWUSR, dir,
+			  &dev->reg_cache_en);
+	debugfs_create_file("reg_cache", S_IRUSR, dir, dev, &fops_reg_cache);
+	debugfs_create_file("posted_wr", S_IRUSR, dir, dev, &fops_posted_wr);
+	debugfs_create_file("poll_stat", S_IRUSR, dir, dev, &fops_poll_stat);
+	debugfs_create_file("usb_stats", S_IRUSR | S_IWUSR, dir, dev,
+			    &fops_usb_stats);
+	debugfs_create_file("wr_batch", S_IRUSR, dir, dev, &fops_wr_batch);
+	debugfs_create_file("mcu_stat", S_IRUSR, dir, dev, &fops_mcu_stat);
+	debugfs_create_file("read_bench", S_IRUSR | S_IWUSR, dir, dev,
+			    &fops_read_bench);
+	debugfs_create_file("write_bench", S_IRUSR | S_IWUSR, dir, dev,
+			    &fops_write_bench);
+	debugfs_create_u16("rd_burst_min", S_IRUSR | S_IWUSR, dir,
+			   &dev->rd_burst_min);
+	debugfs_create_u8("mcu_rmw", S_IRUSR | S_IWUSR, dir, &dev->mcu_rmw);
+	debugfs_create_u8("rf_mcu", S_IRUSR | S_IWUSR, dir, &dev->rf_mcu);
+	debugfs_create_file("xfers", S_IRUSR | S_IWUSR, dir, dev, &fops_xfers);
+	debugfs_create_file("cal_cache", S_IRUSR | S_IWUSR, dir, dev,
+			    &fops_cal_cache);
+	debugfs_create_u8("vend_breaker_thresh", S_IRUSR | S_IWUSR, dir,
+			  &dev->vend_breaker_thresh);
 }
@@ -293,6 +293,7 @@ static void mt7601u_complete_tx(struct urb *urb)
 	struct mt7601u_dev *dev = q->dev;
 	struct sk_buff *skb;
 	unsigned long flags;
+	bool no_ack;
 
 	spin_lock_irqsave(&dev->tx_lock, flags);
 
@@ -307,6 +308,8 @@ static void mt7601u_complete_tx(struct urb *urb)
 	trace_tx_dma_done(skb);
 
 	dma_unmap_single(dev->dev, q->e[q->start].dma, skb->len, DMA_TO_DEVICE);
+	/* Note: mt7601u_tx_status() may free the skb */
+	no_ack = IEEE80211_SKB_CB(skb)->flags & IEEE80211_TX_CTL_NO_ACK;
 	mt7601u_tx_status(dev, skb);
 
 	if (q->entries <= q->used)
@@ -315,13 +318,25 @@ static void mt7601u_complete_tx(struct urb *urb)
 	q->start = (q->start + 1) % q->entries;
 	q->used--;
 
-	if (urb->status)
+	/* Only frames waiting for an ACK drive the status polling */
+	if (urb->status || no_ack)
 		goto out;
 
-	__set_bit(MT7601U_STATE_MORE_STATS, &dev->state);
-	if (!__test_and_set_bit(MT7601U_STATE_READING_STATS, &dev->state))
+	dev->tx_stat_pending++;
+	if (!__test_and_set_bit(MT7601U_STATE_READING_STATS, &dev->state)) {
+		dev->tx_stat_delay = MT_TX_STAT_MIN_DELAY_US;
+		dev->tx_stat_idle = 0;
+		dev->tx_stat_kicked = false;
+		dev->tx_stat_last = ktime_get();
 		queue_delayed_work(dev->stat_wq, &dev->stat_work,
-				   msecs_to_jiffies(10));
+				   usecs_to_jiffies(MT_TX_STAT_MIN_DELAY_US));
+	} else if (!dev->tx_stat_kicked &&
+		   dev->tx_stat_pending >= MT_TX_STAT_FIFO_DEPTH / 2) {
+		/* Don't wait for the timer if FIFO is about to overflow */
+		mod_delayed_work(dev->stat_wq, &dev->stat_work, 0);
+		dev->tx_stat_kicked = true;
+		dev->txs_stats.kicks++;
+	}
 out:
 	spin_unlock_irqrestore(&dev->tx_lock, flags);
 }
@@ -39,8 +39,8 @@ static int
 mt7601u_efuse_read(struct mt7601u_dev *dev, u16 addr, u8 *data,
 		   enum mt7601u_eeprom_access_modes mode)
 {
-	u32 val;
-	int i;
+	u32 val, vals[4];
+	int i, ret;
 
 	val = mt76_rr(dev, MT_EFUSE_CTRL);
 	val &= ~(MT_EFUSE_CTRL_AIN |
@@ -62,10 +62,12 @@ mt7601u_efuse_read(struct mt7601u_dev *dev, u16 addr, u8 *data,
 		return 0;
 	}
 
-	for (i = 0; i < 4; i++) {
-		val = mt76_rr(dev, MT_EFUSE_DATA(i));
-		put_unaligned_le32(val, data + 4 * i);
-	}
+	ret = mt7601u_rr_bulk(dev, MT_EFUSE_DATA(0), vals, ARRAY_SIZE(vals));
+	if (ret)
+		return ret;
+
+	for (i = 0; i < 4; i++)
+		put_unaligned_le32(vals[i], data + 4 * i);
 
 	return 0;
 }
@@ -134,7 +136,7 @@ mt7601u_set_chip_cap(struct mt7601u_dev *dev, u8 *eeprom)
 			"Error: device has more than 1 RX/TX stream!\n");
 }
 
-static int
+static void
 mt7601u_set_macaddr(struct mt7601u_dev *dev, const u8 *eeprom)
 {
 	const void *src = eeprom + MT_EE_MAC_ADDR;
@@ -147,12 +149,13 @@ mt7601u_set_macaddr(struct mt7601u_dev *dev, const u8 *eeprom)
 			 "Invalid MAC address, using random address %pM\n",
 			 dev->macaddr);
 	}
+}
 
+static void mt7601u_write_macaddr(struct mt7601u_dev *dev)
+{
 	mt76_wr(dev, MT_MAC_ADDR_DW0, get_unaligned_le32(dev->macaddr));
 	mt76_wr(dev, MT_MAC_ADDR_DW1, get_unaligned_le16(dev->macaddr + 4) |
 		MT76_SET(MT_MAC_ADDR_DW1_U2ME_MASK, 0xff));
-
-	return 0;
 }
 
 static void mt7601u_set_channel_target_power(struct mt7601u_dev *dev,
@@ -365,6 +368,10 @@ mt7601u_init_tssi_params(struct mt7601u_dev *dev, u8 *eeprom)
 	d->offset[2] = eeprom[MT_EE_TX_TSSI_OFFSET_GROUP + 2];
 }
 
+/* Read and parse the EEPROM, only what mac80211 registration needs and
+ * what doesn't depend on MAC init values.  The rest is done by
+ * mt7601u_eeprom_apply() once the hardware is up.
+ */
 int
 mt7601u_eeprom_init(struct mt7601u_dev *dev)
 {
@@ -379,14 +386,15 @@ mt7601u_eeprom_init(struct mt7601u_dev *dev)
 	if (!dev->ee)
 		return -ENOMEM;
 
-	eeprom = kmalloc(MT7601U_EEPROM_SIZE, GFP_KERNEL);
+	eeprom = devm_kmalloc(dev->dev, MT7601U_EEPROM_SIZE, GFP_KERNEL);
 	if (!eeprom)
 		return -ENOMEM;
+	dev->ee->data = eeprom;
 
 	for (i = 0; i + 16 <= MT7601U_EEPROM_SIZE; i += 16) {
 		ret = mt7601u_efuse_read(dev, i, eeprom + i, MT_EE_READ);
 		if (ret)
-			goto out;
+			return ret;
 	}
 
 	if (eeprom[MT_EE_VERSION_EE] > MT7601U_EE_MAX_VER)
@@ -398,17 +406,23 @@ mt7601u_eeprom_init(struct mt7601u_dev *dev)
 
 	mt7601u_set_macaddr(dev, eeprom);
 	mt7601u_set_chip_cap(dev, eeprom);
-	mt7601u_set_channel_power(dev, eeprom);
 	mt7601u_set_country_reg(dev, eeprom);
 	mt7601u_set_rf_freq_off(dev, eeprom);
 	mt7601u_set_rssi_offset(dev, eeprom);
 	dev->ee->ref_temp = eeprom[MT_EE_REF_TEMP];
 	dev->ee->lna_gain = eeprom[MT_EE_LNA_GAIN];
 
-	mt7601u_config_tx_power_per_rate(dev, eeprom);
-
 	mt7601u_init_tssi_params(dev, eeprom);
-out:
-	kfree(eeprom);
-	return ret;
+
+	return 0;
+}
+
+/* Program EEPROM derived values, must be called after MAC init */
+void mt7601u_eeprom_apply(struct mt7601u_dev *dev)
+{
+	u8 *eeprom = dev->ee->data;
+
+	mt7601u_write_macaddr(dev);
+	mt7601u_set_channel_power(dev, eeprom);
+	mt7601u_config_tx_power_per_rate(dev, eeprom);
 }
@@ -118,9 +118,13 @@ struct mt7601u_eeprom_params {
 	} tssi_data;
 
 	struct reg_channel_bounds reg;
+
+	/* Raw EEPROM for mt7601u_eeprom_apply() */
+	u8 *data;
 };
 
 int mt7601u_eeprom_init(struct mt7601u_dev *dev);
+void mt7601u_eeprom_apply(struct mt7601u_dev *dev);
 
 static inline u32 s6_validate(u32 reg)
 {
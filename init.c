@@ -17,6 +17,7 @@
 #include "eeprom.h"
 #include "trace.h"
 #include "mcu.h"
+#include "usb.h"
 
 static void
 mt7601u_set_wlan_state(struct mt7601u_dev *dev, u32 val, bool enable)
@@ -90,9 +91,81 @@ static void mt7601u_chip_onoff(struct mt7601u_dev *dev, bool enable, bool reset)
 
 	mt7601u_set_wlan_state(dev, val, enable);
 
+	mt7601u_reg_cache_invalidate(dev);
+	mt7601u_bbp_cache_invalidate(dev);
+
 	mutex_unlock(&dev->hw_atomic_mutex);
 }
 
+/* BBP registers changed by the hardware (version, sensor readouts,
+ * self-clearing TSSI triggers, indirect access data windows), these are
+ * never served from the shadow.
+ */
+static bool mt7601u_bbp_volatile(u8 offset)
+{
+	switch (offset) {
+	case MT_BBP_REG_VERSION:
+	case 21:
+	case 22:
+	case 47:
+	case 49:
+	case 159:
+	case 196:
+	case 244:
+		return true;
+	default:
+		return false;
+	}
+}
+
+static bool mt7601u_bbp_cache_get(struct mt7601u_dev *dev, u8 offset, u8 *val)
+{
+	bool hit;
+
+	if (mt7601u_bbp_volatile(offset))
+		return false;
+
+	spin_lock_bh(&dev->reg_cache_lock);
+	dev->bbp_cache_stats.reads++;
+	hit = dev->reg_cache_en && test_bit(offset, dev->bbp_cache_valid);
+	if (hit) {
+		dev->bbp_cache_stats.hits++;
+		*val = dev->bbp_cache[offset];
+	}
+	spin_unlock_bh(&dev->reg_cache_lock);
+
+	return hit;
+}
+
+/* Write-through, also for writes done via the MCU.  With partial @mask
+ * the shadow is only updated if it's already valid.
+ */
+void mt7601u_bbp_cache_rmw(struct mt7601u_dev *dev, u8 offset, u8 mask, u8 val)
+{
+	if (mt7601u_bbp_volatile(offset))
+		return;
+
+	spin_lock_bh(&dev->reg_cache_lock);
+	if (mask == 0xff) {
+		dev->bbp_cache[offset] = val;
+		__set_bit(offset, dev->bbp_cache_valid);
+		dev->bbp_cache_stats.writes++;
+	} else if (test_bit(offset, dev->bbp_cache_valid)) {
+		dev->bbp_cache[offset] &= ~mask;
+		dev->bbp_cache[offset] |= val;
+		dev->bbp_cache_stats.writes++;
+	}
+	spin_unlock_bh(&dev->reg_cache_lock);
+}
+
+void mt7601u_bbp_cache_invalidate(struct mt7601u_dev *dev)
+{
+	spin_lock_bh(&dev->reg_cache_lock);
+	bitmap_zero(dev->bbp_cache_valid, MT_BBP_CACHE_SIZE);
+	dev->bbp_cache_stats.resyncs++;
+	spin_unlock_bh(&dev->reg_cache_lock);
+}
+
 u8 mt7601u_bbp_rr(struct mt7601u_dev *dev, u8 offset)
 {
 	u32 val;
@@ -105,6 +178,11 @@ u8 mt7601u_bbp_rr(struct mt7601u_dev *dev, u8 offset)
 	if (test_bit(MT7601U_STATE_REMOVED, &dev->state))
 		return 0xff;
 
+	if (mt7601u_bbp_cache_get(dev, offset, &ret)) {
+		trace_bbp_read(offset, ret);
+		return ret;
+	}
+
 	mutex_lock(&dev->reg_atomic_mutex);
 
 	if (!mt76_poll(dev, MT_BBP_CSR_CFG, MT_BBP_CSR_CFG_BUSY, 0, 1000)) {
@@ -129,6 +207,7 @@ u8 mt7601u_bbp_rr(struct mt7601u_dev *dev, u8 offset)
 		goto out;
 	}
 	ret = MT76_GET(MT_BBP_CSR_CFG_VAL, val);
+	mt7601u_bbp_cache_rmw(dev, offset, 0xff, ret);
 out:
 	mutex_unlock(&dev->reg_atomic_mutex);
 
@@ -155,6 +234,7 @@ void mt7601u_bbp_wr(struct mt7601u_dev *dev, u8 offset, u8 val)
 	mt7601u_wr(dev, MT_BBP_CSR_CFG,
 		   val | MT76_SET(MT_BBP_CSR_CFG_REG_NUM, offset) |
 		   MT_BBP_CSR_CFG_RW_MODE | MT_BBP_CSR_CFG_BUSY);
+	mt7601u_bbp_cache_rmw(dev, offset, 0xff, val);
 out:
 	mutex_unlock(&dev->reg_atomic_mutex);
 	trace_bbp_write(offset, val);
@@ -168,6 +248,17 @@ u8 mt7601u_bbp_rmw(struct mt7601u_dev *dev, u8 offset, u8 mask, u8 val)
 	return val;
 }
 
+/* Same as bbp_rmw but done by the MCU when possible, new value is not
+ * returned.  R47/R49 select and read out sensor values, they are never
+ * handed to the firmware.
+ */
+void mt7601u_bbp_rmw_mcu(struct mt7601u_dev *dev, u8 offset, u8 mask, u8 val)
+{
+	if (offset == 47 || offset == 49 ||
+	    mt7601u_mcu_rmw(dev, MT_MCU_MEMMAP_BBP, offset, mask, val))
+		mt7601u_bbp_rmw(dev, offset, mask, val);
+}
+
 u8 mt7601u_bbp_rmc(struct mt7601u_dev *dev, u8 offset, u8 mask, u8 val)
 {
 	u8 reg = mt7601u_bbp_rr(dev, offset);
@@ -325,6 +416,8 @@ static void mt7601u_reset_csr_bbp(struct mt7601u_dev *dev)
 	mt7601u_wr(dev, MT_USB_DMA_CFG, 0);
 	msleep(1);
 	mt7601u_wr(dev, MT_MAC_SYS_CTRL, 0);
+
+	mt7601u_bbp_cache_invalidate(dev);
 }
 
 static int mt7601u_write_mac_initvals(struct mt7601u_dev *dev)
@@ -446,12 +539,10 @@ static int mt7601u_init_wcid_attr_mem(struct mt7601u_dev *dev)
 
 static void mt7601u_reset_counters(struct mt7601u_dev *dev)
 {
-	mt7601u_rr(dev, MT_RX_STA_CNT0);
-	mt7601u_rr(dev, MT_RX_STA_CNT1);
-	mt7601u_rr(dev, MT_RX_STA_CNT2);
-	mt7601u_rr(dev, MT_TX_STA_CNT0);
-	mt7601u_rr(dev, MT_TX_STA_CNT1);
-	mt7601u_rr(dev, MT_TX_STA_CNT2);
+	u32 cnt[6];
+
+	/* RX_STA_CNT0-2 and TX_STA_CNT0-2 are clear-on-read */
+	mt7601u_rr_bulk(dev, MT_RX_STA_CNT0, cnt, ARRAY_SIZE(cnt));
 }
 
 static void mt7601u_set_default_edca(struct mt7601u_dev *dev)
@@ -470,6 +561,8 @@ static void mt7601u_set_default_edca(struct mt7601u_dev *dev)
 	u32 val;
 	int i;
 
+	mt7601u_wr_batch_begin(dev);
+
 	for (i = 0; i < 2; i++) {
 		val = MT76_SET(MT_EDCA_CFG_TXOP, params[i].txop) |
 			MT76_SET(MT_EDCA_CFG_AIFSN, params[i].aifs) |
@@ -507,6 +600,8 @@ static void mt7601u_set_default_edca(struct mt7601u_dev *dev)
 
 	val = 0x0293;
 	mt76_wr(dev, MT_WMM_AIFSN, val);
+
+	mt7601u_wr_batch_commit(dev);
 }
 
 int mt7601u_mac_start(struct mt7601u_dev *dev)
@@ -609,6 +704,20 @@ static void mt7601u_stop_hardware(struct mt7601u_dev *dev)
 	mt7601u_chip_onoff(dev, false, false);
 }
 
+/* First stage of probe, just enough to register with mac80211 */
+int mt7601u_init_early(struct mt7601u_dev *dev)
+{
+	int ret;
+
+	mt7601u_chip_onoff(dev, true, false);
+
+	ret = mt7601u_wait_asic_ready(dev);
+	if (ret)
+		return ret;
+
+	return mt7601u_eeprom_init(dev);
+}
+
 int mt7601u_init_hardware(struct mt7601u_dev *dev)
 {
 	static const u16 beacon_offsets[16] = {
@@ -630,17 +739,14 @@ int mt7601u_init_hardware(struct mt7601u_dev *dev)
 		0xdc00,
 		0xde00
 	};
+	ktime_t start;
+	u64 cmds;
 	int ret;
 	u32 val;
 
 	dev->beacon_offsets = beacon_offsets;
 
-	mt7601u_chip_onoff(dev, true, false);
-
-	ret = mt7601u_wait_asic_ready(dev);
-	if (ret)
-		goto err;
-
+	/* Note: chip was already turned on by mt7601u_init_early() */
 	ret = mt7601u_mcu_init(dev);
 	if (ret)
 		goto err;
@@ -728,14 +834,20 @@ int mt7601u_init_hardware(struct mt7601u_dev *dev)
 
 	mt7601u_wr(dev, MT_TXOP_CTRL_CFG, 0x583f);
 
-	ret = mt7601u_eeprom_init(dev);
-	if (ret)
-		goto err_rx;
+	mt7601u_eeprom_apply(dev);
+
+	cmds = dev->mcu.stats.cmds;
+	start = ktime_get();
 
 	ret = mt7601u_phy_init(dev);
 	if (ret)
 		goto err_rx;
 
+	dev->mcu.stats.phy_init_us = ktime_us_delta(ktime_get(), start);
+	dev->mcu.stats.phy_init_cmds = dev->mcu.stats.cmds - cmds;
+	dev_dbg(dev->dev, "PHY init: %uus, %u MCU commands\n",
+		dev->mcu.stats.phy_init_us, dev->mcu.stats.phy_init_cmds);
+
 	mt7601u_set_rx_path(dev, 0);
 	mt7601u_set_tx_dac(dev, 0);
 
@@ -758,6 +870,7 @@ err:
 void mt7601u_cleanup(struct mt7601u_dev *dev)
 {
 	mt7601u_stop_hardware(dev);
+	mt7601u_vendor_flush(dev);
 	mt7601u_dma_cleanup(dev);
 	mt7601u_mcu_cmd_deinit(dev);
 }
@@ -774,6 +887,11 @@ struct mt7601u_dev *mt7601u_alloc_device(struct device *pdev)
 	dev = hw->priv;
 	dev->dev = pdev;
 	dev->hw = hw;
+	dev->vend_buf = devm_kmalloc(pdev, MT_VEND_BUF, GFP_KERNEL);
+	if (!dev->vend_buf) {
+		ieee80211_free_hw(hw);
+		return NULL;
+	}
 	mutex_init(&dev->vendor_req_mutex);
 	mutex_init(&dev->reg_atomic_mutex);
 	mutex_init(&dev->hw_atomic_mutex);
@@ -782,7 +900,20 @@ struct mt7601u_dev *mt7601u_alloc_device(struct device *pdev)
 	spin_lock_init(&dev->rx_lock);
 	spin_lock_init(&dev->lock);
 	spin_lock_init(&dev->last_beacon.lock);
-	atomic_set(&dev->avg_ampdu_len, 1);
+	spin_lock_init(&dev->reg_cache_lock);
+	spin_lock_init(&dev->posted_lock);
+	spin_lock_init(&dev->poll_lock);
+	init_waitqueue_head(&dev->io_wq);
+	init_usb_anchor(&dev->posted_anchor);
+	INIT_LIST_HEAD(&dev->posted_wrs);
+	init_completion(&dev->init_done);
+	mt7601u_mcu_early_init(dev);
+	dev->reg_cache_en = 1;
+	dev->mcu_rmw = 1;
+	dev->rf_mcu = 1;
+	dev->vend_breaker_thresh = MT7601U_VENDOR_BREAKER_THRESH;
+	dev->tx_stat_batch = 1;
+	dev->ht_fbk = dev->ht_fbk_req = MT_HT_FBK_CFG0_DEFAULT;
 
 	dev->stat_wq = alloc_workqueue("mt7601u", WQ_UNBOUND, 0);
 	if (!dev->stat_wq) {
@@ -926,12 +1057,12 @@ int mt7601u_register_device(struct mt7601u_dev *dev)
 		    IEEE80211_HW_PS_NULLFUNC_STACK |
 		    IEEE80211_HW_SUPPORTS_HT_CCK_RATES |
 		    IEEE80211_HW_AMPDU_AGGREGATION |
-#ifdef MAC80211_IS_PATCHED
-		    IEEE80211_HW_TX_STATS_EVERY_MPDU |
-#endif
 		    IEEE80211_HW_SUPPORTS_RC_TABLE;
-	hw->max_rates = 1;
-	hw->max_report_rates = 7;
+	/* Note: only the fallback between rates can be controlled, each rate
+	 *	 of the table is tried once (see mt7601u_mac_set_ht_fbk()).
+	 */
+	hw->max_rates = IEEE80211_TX_MAX_RATES;
+	hw->max_report_rates = IEEE80211_TX_MAX_RATES;
 	hw->max_rate_tries = 1;
 
 	hw->sta_data_size = sizeof(struct mt76_sta);
@@ -950,6 +1081,7 @@ int mt7601u_register_device(struct mt7601u_dev *dev)
 
 	INIT_DELAYED_WORK(&dev->mac_work, mt7601u_mac_work);
 	INIT_DELAYED_WORK(&dev->stat_work, mt7601u_tx_stat);
+	INIT_WORK(&dev->fbk_work, mt7601u_mac_fbk_work);
 
 	ret = ieee80211_register_hw(hw);
 	if (ret)
@@ -14,6 +14,7 @@
 
 #include "mt7601u.h"
 #include "trace.h"
+#include "mcu.h"
 #include <linux/etherdevice.h>
 
 static void
@@ -69,35 +70,66 @@ mt76_mac_process_tx_rate(struct ieee80211_tx_rate *txrate, u16 rate,
 		txrate->flags |= IEEE80211_TX_RC_SHORT_GI;
 }
 
+/* Walk the fallback chain from the requested to the effective rate using
+ * the HT fallback table in @st.  Returns number of fallback steps taken, MCS
+ * values tried are put in @chain.
+ */
+int mt7601u_mac_tx_fbk_chain(const struct mt76_tx_status *st, u8 *chain)
+{
+	bool ht = MT76_GET(MT_TXWI_RATE_PHY_MODE, st->rate) >= MT_PHY_TYPE_HT;
+	u8 eff = st->rate & 0x7, mcs = st->req_rate, next;
+	u32 fbk = st->ht_fbk;
+	int n = 0;
+
+	chain[0] = mcs;
+	while (mcs != eff && mcs && n < MT_TX_FBK_CHAIN_MAX - 1) {
+		next = ht ? (fbk >> (mcs * 4)) & 0x7 : mcs - 1;
+		if (next >= mcs)
+			break;
+
+		mcs = next;
+		chain[++n] = mcs;
+	}
+	if (mcs == eff)
+		return n;
+
+	/* Table must have changed in the meantime, assume default fallback */
+	n = max_t(int, 0, st->req_rate - eff);
+	for (mcs = 0; mcs <= n; mcs++)
+		chain[mcs] = eff + n - mcs;
+
+	return n;
+}
+
 void
 mt76_mac_fill_tx_status(struct mt7601u_dev *dev, struct ieee80211_tx_info *info,
 			struct mt76_tx_status *st)
 {
 	struct ieee80211_tx_rate *rate = info->status.rates;
-	int cur_idx, last_rate;
-	int i;
+	u8 chain[MT_TX_FBK_CHAIN_MAX];
+	int steps, tries, last, i;
 
-	last_rate = min_t(int, st->retry, IEEE80211_TX_MAX_RATES - 1);
-	mt76_mac_process_tx_rate(&rate[last_rate], st->rate,
+	/* Hardware moves one step down the fallback table with every retry,
+	 * once the end of the chain is reached all remaining retries are done
+	 * at the lowest rate.
+	 */
+	steps = mt7601u_mac_tx_fbk_chain(st, chain);
+	tries = min_t(int, st->retry + 1, 31);
+	last = min3(steps, tries - 1, IEEE80211_TX_MAX_RATES - 1);
+
+	mt76_mac_process_tx_rate(&rate[last], st->rate,
 				 dev->chandef.chan->band);
-	if (last_rate < IEEE80211_TX_MAX_RATES - 1)
-		rate[last_rate + 1].idx = -1;
+	rate[last].count = tries - last;
+	if (last < IEEE80211_TX_MAX_RATES - 1)
+		rate[last + 1].idx = -1;
 
-	cur_idx = rate[last_rate].idx + st->retry;
-	for (i = 0; i <= last_rate; i++) {
-		rate[i].flags = rate[last_rate].flags;
-		rate[i].idx = max_t(int, 0, cur_idx - i);
+	for (i = 0; i < last; i++) {
+		rate[i].flags = rate[last].flags;
+		rate[i].idx = rate[last].idx + chain[i] - chain[steps];
 		rate[i].count = 1;
 	}
 
-	if (last_rate > 0)
-		rate[last_rate - 1].count = st->retry + 1 - last_rate;
-
-#ifdef MAC80211_IS_PATCHED
-	info->status.ampdu_len = atomic_read(&dev->avg_ampdu_len);
-#else
 	info->status.ampdu_len = 1;
-#endif
 	info->status.ampdu_ack_len = st->success;
 
 	if (st->is_probe)
@@ -166,13 +198,10 @@ void mt76_mac_wcid_set_rate(struct mt7601u_dev *dev, struct mt76_wcid *wcid,
 	spin_unlock_irqrestore(&dev->lock, flags);
 }
 
-struct mt76_tx_status
-mt7601u_mac_fetch_tx_status(struct mt7601u_dev *dev)
+static struct mt76_tx_status mt7601u_mac_parse_tx_status(u32 val)
 {
 	struct mt76_tx_status stat = {};
-	u32 val;
 
-	val = mt7601u_rr(dev, MT_TX_STAT_FIFO);
 	stat.valid = !!(val & MT_TX_STAT_FIFO_VALID);
 	stat.success = !!(val & MT_TX_STAT_FIFO_SUCCESS);
 	stat.aggr = !!(val & MT_TX_STAT_FIFO_AGGR);
@@ -184,6 +213,94 @@ mt7601u_mac_fetch_tx_status(struct mt7601u_dev *dev)
 	return stat;
 }
 
+static void
+mt7601u_mac_parse_tx_status_ext(struct mt76_tx_status *stat, u32 val)
+{
+	stat->retry = MT76_GET(MT_TX_STAT_FIFO_EXT_RETRY, val);
+	stat->has_ext = true;
+}
+
+/* Note: EXT_FIFO has to be read first, reading TX_STAT_FIFO pops both. */
+struct mt76_tx_status
+mt7601u_mac_fetch_tx_status(struct mt7601u_dev *dev)
+{
+	struct mt76_tx_status stat;
+	bool ext = dev->tx_stat_ext;
+	u32 ext_val = 0;
+
+	if (ext) {
+		ext_val = mt7601u_rr(dev, MT_TX_STAT_FIFO_EXT);
+		dev->txs_stats.usb_xfers++;
+	}
+
+	stat = mt7601u_mac_parse_tx_status(mt7601u_rr(dev, MT_TX_STAT_FIFO));
+	if (ext)
+		mt7601u_mac_parse_tx_status_ext(&stat, ext_val);
+
+	return stat;
+}
+
+/* Note: TX_STAT_FIFO sits in the middle of the clear-on-read statistic
+ *	 counters so multi-dword vendor reads can't be used to drain it.
+ *	 Instead ask the MCU to pop the FIFO @n times in one inband command.
+ */
+static int
+mt7601u_mac_fetch_tx_status_mcu(struct mt7601u_dev *dev,
+				struct mt76_tx_status *stat, int n)
+{
+	struct mt76_reg_pair rp[MT_TX_STAT_BATCH * 2] = {};
+	bool ext = dev->tx_stat_ext;
+	int i, ret, per_stat = ext ? 2 : 1;
+
+	n = min_t(int, n, MT_TX_STAT_BATCH);
+
+	for (i = 0; i < n; i++) {
+		if (ext)
+			rp[i * 2].reg = MT_TX_STAT_FIFO_EXT;
+		rp[(i + 1) * per_stat - 1].reg = MT_TX_STAT_FIFO;
+	}
+
+	ret = mt7601u_read_reg_pairs(dev, MT_MCU_MEMMAP_WLAN, rp, n * per_stat);
+	if (ret)
+		return ret;
+
+	for (i = 0; i < n; i++) {
+		u32 val = rp[(i + 1) * per_stat - 1].value;
+
+		stat[i] = mt7601u_mac_parse_tx_status(val);
+		if (ext)
+			mt7601u_mac_parse_tx_status_ext(&stat[i],
+							rp[i * 2].value);
+	}
+
+	return n;
+}
+
+/* Fetch up to @n entries from the TX status FIFO.  Returns number of entries
+ * written to @stat, entries may be invalid if FIFO got drained in the middle
+ * of a batch.
+ */
+int mt7601u_mac_fetch_tx_status_batch(struct mt7601u_dev *dev,
+				      struct mt76_tx_status *stat, int n)
+{
+	int ret;
+
+	if (n > 1 && dev->tx_stat_batch &&
+	    test_bit(MT7601U_STATE_MCU_RUNNING, &dev->state)) {
+		ret = mt7601u_mac_fetch_tx_status_mcu(dev, stat, n);
+		dev->txs_stats.usb_xfers++;
+		if (ret > 0)
+			return ret;
+
+		dev->txs_stats.batch_errors++;
+	}
+
+	stat[0] = mt7601u_mac_fetch_tx_status(dev);
+	dev->txs_stats.usb_xfers++;
+
+	return 1;
+}
+
 void mt7601u_mac_set_protection(struct mt7601u_dev *dev, bool legacy_prot,
 				int ht_mode)
 {
@@ -252,8 +369,13 @@ void mt7601u_mac_set_protection(struct mt7601u_dev *dev, bool legacy_prot,
 		if (ht_rts[i])
 			prot[i + 2] |= MT_PROT_CTRL_RTS_CTS;
 
+	/* Note: the batch swallows the posted writes, all six registers go
+	 *	 out as one synchronous MCU command on commit.
+	 */
+	mt7601u_wr_batch_begin(dev);
 	for (i = 0; i < 6; i++)
-		mt7601u_wr(dev, MT_CCK_PROT_CFG + i * 4, prot[i]);
+		mt7601u_wr_posted(dev, MT_CCK_PROT_CFG + i * 4, prot[i]);
+	mt7601u_wr_batch_commit(dev);
 }
 
 void mt7601u_mac_set_short_preamble(struct mt7601u_dev *dev, bool short_preamb)
@@ -302,50 +424,52 @@ void mt7601u_mac_work(struct work_struct *work)
 {
 	struct mt7601u_dev *dev = container_of(work, struct mt7601u_dev,
 					       mac_work.work);
+	/* Note: TX_STAT_FIFO (0x1718) sits between the counters and must not
+	 *	 be read here, contents of 0x1744-0x1748 are unknown.
+	 */
+	u32 sta_cnt[6], agg_cnt0[10], agg_cnt1[8];
 	struct {
 		u32 addr_base;
 		u32 span;
 		u64 *stat_base;
+		u32 *val;
 	} spans[] = {
-		{ MT_RX_STA_CNT0,	3,	dev->stats.rx_stat },
-		{ MT_TX_STA_CNT0,	3,	dev->stats.tx_stat },
-		{ MT_TX_AGG_STAT,	1,	dev->stats.aggr_stat },
-		{ MT_MPDU_DENSITY_CNT,	1,	dev->stats.zero_len_del },
-		{ MT_TX_AGG_CNT_BASE0,	8,	&dev->stats.aggr_n[0] },
-		{ MT_TX_AGG_CNT_BASE1,	8,	&dev->stats.aggr_n[16] },
+		{ MT_RX_STA_CNT0,	3, dev->stats.rx_stat,	 sta_cnt },
+		{ MT_TX_STA_CNT0,	3, dev->stats.tx_stat,	 sta_cnt + 3 },
+		{ MT_TX_AGG_STAT,	1, dev->stats.aggr_stat, agg_cnt0 },
+		{ MT_MPDU_DENSITY_CNT,	1, dev->stats.zero_len_del,
+					   agg_cnt0 + 9 },
+		{ MT_TX_AGG_CNT_BASE0,	8, dev->stats.aggr_n,	 agg_cnt0 + 1 },
+		{ MT_TX_AGG_CNT_BASE1,	8, &dev->stats.aggr_n[16], agg_cnt1 },
 	};
-	u32 sum, n;
-	int i, j, k;
+	ktime_t start = ktime_get();
+	int i, j;
 
 	/* Note: using MCU_RANDOM_READ is actually slower then reading all the
 	 *	 registers by hand.  MCU takes ca. 20ms to complete read of 24
 	 *	 registers while reading them one by one will take roughly
-	 *	 24*200us =~ 5ms.
+	 *	 24*200us =~ 5ms.  Read the counters in 3 bulk reads instead.
+	 *	 Those may turn into MCU burst reads if the read benchmark
+	 *	 (debugfs read_bench) finds them faster.
 	 */
+	if (mt7601u_rr_bulk(dev, MT_RX_STA_CNT0, sta_cnt,
+			    ARRAY_SIZE(sta_cnt)) ||
+	    mt7601u_rr_bulk(dev, MT_TX_AGG_STAT, agg_cnt0,
+			    ARRAY_SIZE(agg_cnt0)) ||
+	    mt7601u_rr_bulk(dev, MT_TX_AGG_CNT_BASE1, agg_cnt1,
+			    ARRAY_SIZE(agg_cnt1)))
+		goto out;
 
-	k = 0;
-	n = 0;
-	sum = 0;
 	for (i = 0; i < ARRAY_SIZE(spans); i++)
 		for (j = 0; j < spans[i].span; j++) {
-			u32 val = mt7601u_rr(dev, spans[i].addr_base + j * 4);
+			u32 val = spans[i].val[j];
 
 			spans[i].stat_base[j * 2] += val & 0xffff;
 			spans[i].stat_base[j * 2 + 1] += val >> 16;
-
-			/* Calculate average AMPDU length */
-			if (spans[i].addr_base != MT_TX_AGG_CNT_BASE0 &&
-			    spans[i].addr_base != MT_TX_AGG_CNT_BASE1)
-				continue;
-
-			n += (val >> 16) + (val & 0xffff);
-			sum += (val & 0xffff) * (1 + k * 2) +
-				(val >> 16) * (2 + k * 2);
-			k++;
 		}
 
-	atomic_set(&dev->avg_ampdu_len, n ? DIV_ROUND_CLOSEST(sum, n) : 1);
-
+	dev->stats.work_us = ktime_us_delta(ktime_get(), start);
+out:
 	mt7601u_check_mac_err(dev);
 
 	ieee80211_queue_delayed_work(dev->hw, &dev->mac_work, 10 * HZ);
@@ -378,6 +502,56 @@ void mt7601u_mac_set_ampdu_factor(struct mt7601u_dev *dev,
 		   MT76_SET(MT_MAX_LEN_CFG_AMPDU, cap->ampdu_factor));
 }
 
+/* Translate rate control's rate table into the HT fallback table.  Hardware
+ * moves down the table on every retry so only strictly decreasing single
+ * stream MCS links with identical flags can be expressed, remaining rates
+ * keep the default fallback.
+ */
+void mt7601u_mac_set_ht_fbk(struct mt7601u_dev *dev,
+			    const struct ieee80211_sta_rates *rates)
+{
+	u32 fbk = MT_HT_FBK_CFG0_DEFAULT;
+	unsigned long flags;
+	int i;
+
+	for (i = 1; rates && i < IEEE80211_TX_MAX_RATES; i++) {
+		s8 hi = rates->rate[i - 1].idx, lo = rates->rate[i].idx;
+
+		if (!(rates->rate[0].flags & IEEE80211_TX_RC_MCS) ||
+		    rates->rate[i].flags != rates->rate[0].flags ||
+		    lo < 0 || hi >= 8 || lo >= hi)
+			break;
+
+		fbk &= ~(0xfU << (hi * 4));
+		fbk |= lo << (hi * 4);
+	}
+
+	spin_lock_irqsave(&dev->lock, flags);
+	if (dev->ht_fbk_req != fbk) {
+		dev->ht_fbk_req = fbk;
+		ieee80211_queue_work(dev->hw, &dev->fbk_work);
+	}
+	spin_unlock_irqrestore(&dev->lock, flags);
+}
+
+void mt7601u_mac_fbk_work(struct work_struct *work)
+{
+	struct mt7601u_dev *dev = container_of(work, struct mt7601u_dev,
+					       fbk_work);
+	unsigned long flags;
+	u32 fbk;
+
+	spin_lock_irqsave(&dev->lock, flags);
+	fbk = dev->ht_fbk_req;
+	spin_unlock_irqrestore(&dev->lock, flags);
+
+	mt7601u_wr(dev, MT_HT_FBK_CFG0, fbk);
+
+	spin_lock_irqsave(&dev->lock, flags);
+	WRITE_ONCE(dev->ht_fbk, fbk);
+	spin_unlock_irqrestore(&dev->lock, flags);
+}
+
 static void
 mt76_mac_process_rate(struct ieee80211_rx_status *status, u16 rate)
 {
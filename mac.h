@@ -30,12 +30,20 @@ struct mt76_tx_status {
 	u8 aggr:1;
 	u8 ack_req:1;
 	u8 is_probe:1;
+	u8 has_ext:1;
+	u8 stale:1;
 	u8 wcid;
 	u8 pktid;
+	u8 prev_pktid;
 	u8 retry;
+	u8 req_rate;
 	u16 rate;
+	u32 ht_fbk;
 } __packed __aligned(2);
 
+/* Max length of HW rate fallback chain (1 stream MCS) */
+#define MT_TX_FBK_CHAIN_MAX	8
+
 struct mt76_tx_info {
 	unsigned long jiffies;
 	u8 tries;
@@ -239,6 +247,9 @@ u16 mt76_mac_tx_rate_val(struct mt7601u_dev *dev,
 			 const struct ieee80211_tx_rate *rate, u8 *nss_val);
 struct mt76_tx_status
 mt7601u_mac_fetch_tx_status(struct mt7601u_dev *dev);
+int mt7601u_mac_fetch_tx_status_batch(struct mt7601u_dev *dev,
+				      struct mt76_tx_status *stat, int n);
+int mt7601u_mac_tx_fbk_chain(const struct mt76_tx_status *st, u8 *chain);
 void
 mt76_mac_fill_tx_status(struct mt7601u_dev *dev, struct ieee80211_tx_info *info,
 			struct mt76_tx_status *st);
@@ -26,11 +26,22 @@ static int mt7601u_start(struct ieee80211_hw *hw)
 	struct mt7601u_dev *dev = hw->priv;
 	int ret;
 
+	/* Hardware is brought up asynchronously after probe.
+	 * Note: every step of the init has its own timeout, the work always
+	 *	 completes and init_ret tells how it went.
+	 */
+	ret = wait_for_completion_killable(&dev->init_done);
+	if (ret)
+		return ret;
+	if (dev->init_ret)
+		return dev->init_ret;
+
 	mutex_lock(&dev->mutex);
 
 	ret = mt7601u_mac_start(dev);
 	if (ret)
 		goto out;
+	set_bit(MT7601U_STATE_WLAN_RUNNING, &dev->state);
 
 	ieee80211_queue_delayed_work(dev->hw, &dev->mac_work,
 				     MT_CALIBRATE_INTERVAL);
@@ -49,7 +60,9 @@ static void mt7601u_stop(struct ieee80211_hw *hw)
 
 	cancel_delayed_work_sync(&dev->cal_work);
 	cancel_delayed_work_sync(&dev->mac_work);
+	cancel_work_sync(&dev->fbk_work);
 	mt7601u_mac_stop(dev);
+	clear_bit(MT7601U_STATE_WLAN_RUNNING, &dev->state);
 
 	mutex_unlock(&dev->mutex);
 }
@@ -192,12 +205,14 @@ mt7601u_bss_info_changed(struct ieee80211_hw *hw, struct ieee80211_vif *vif,
 	if (changed & BSS_CHANGED_BASIC_RATES) {
 		printk("basic rates: %08x\n", info->basic_rates);
 		/* TODO: make sure those are ok - vendor does 0x15f. */
+		mt7601u_wr_batch_begin(dev);
 		mt7601u_wr(dev, MT_LEGACY_BASIC_RATE, info->basic_rates);
-		/* TODO: properly configure fallback - values are ok */
-		mt7601u_wr(dev, MT_HT_FBK_CFG0, 0x65432100);
+		/* Note: HT_FBK_CFG0 follows rate control's rate table */
+		mt7601u_wr(dev, MT_HT_FBK_CFG0, dev->ht_fbk);
 		mt7601u_wr(dev, MT_HT_FBK_CFG1, 0xedcba980);
 		mt7601u_wr(dev, MT_LG_FBK_CFG0, 0xedcba988);
 		mt7601u_wr(dev, MT_LG_FBK_CFG1, 0x00002100);
+		mt7601u_wr_batch_commit(dev);
 	}
 
 	if (changed & BSS_CHANGED_BEACON_INT)
@@ -276,6 +291,11 @@ mt7601u_sta_add(struct ieee80211_hw *hw, struct ieee80211_vif *vif,
 
 	rcu_assign_pointer(dev->wcid[idx], &msta->wcid);
 
+	/* HT fallback table is device-wide, see mt76_sta_rate_tbl_update() */
+	WRITE_ONCE(dev->n_stas, dev->n_stas + 1);
+	if (dev->n_stas > 1)
+		mt7601u_mac_set_ht_fbk(dev, NULL);
+
 out:
 	mutex_unlock(&dev->mutex);
 
@@ -297,6 +317,8 @@ mt7601u_sta_remove(struct ieee80211_hw *hw, struct ieee80211_vif *vif,
 	//mt76_set(dev, MT_WCID_DROP(idx), MT_WCID_DROP_MASK(idx)); ^
 	dev->wcid_mask[idx / BITS_PER_LONG] &= ~BIT(idx % BITS_PER_LONG);
 	mt7601u_mac_wcid_setup(dev, idx, 0, NULL);
+	WRITE_ONCE(dev->n_stas, dev->n_stas - 1);
+	mt7601u_mac_set_ht_fbk(dev, NULL);
 	mutex_unlock(&dev->mutex);
 
 	return 0;
@@ -434,6 +456,14 @@ mt76_sta_rate_tbl_update(struct ieee80211_hw *hw, struct ieee80211_vif *vif,
 	rate.flags = rates->rate[0].flags;
 	mt76_mac_wcid_set_rate(dev, &msta->wcid, &rate);
 
+	/* Note: there is only one HT fallback table for all stations, tune
+	 *	 it to the rate table only if there is nobody else to break.
+	 */
+	if (READ_ONCE(dev->n_stas) == 1)
+		mt7601u_mac_set_ht_fbk(dev, rates);
+	else
+		mt7601u_mac_set_ht_fbk(dev, NULL);
+
 out:
 	rcu_read_unlock();
 }
@@ -17,7 +17,6 @@
 #include <linux/firmware.h>
 #include <linux/delay.h>
 #include <linux/usb.h>
-#include <linux/skbuff.h>
 
 #include "mt7601u.h"
 #include "dma.h"
@@ -28,133 +27,683 @@
 #define MCU_FW_URB_MAX_PAYLOAD		0x3800
 #define MCU_FW_URB_SIZE			(MCU_FW_URB_MAX_PAYLOAD + 12)
 #define MCU_RESP_URB_SIZE		1024
+#define MCU_CMD_BUF_SIZE		(MT_DMA_HDR_LEN +		\
+					 INBAND_PACKET_MAX_LEN + 4)
+#define MT_MCU_RESP_TOUT_MS		1500
 
 static inline int firmware_running(struct mt7601u_dev *dev)
 {
 	return mt7601u_rr(dev, MT_MCU_COM_REG0) == 1;
 }
 
-static inline void skb_put_le32(struct sk_buff *skb, u32 val)
+static inline void
+mt7601u_mcu_buf_add_le32(struct mt7601u_mcu_buf *b, u32 val)
 {
-	put_unaligned_le32(val, skb_put(skb, 4));
+	put_unaligned_le32(val, b->dma.buf + MT_DMA_HDR_LEN + b->len);
+	b->len += 4;
 }
 
-static inline void mt7601u_dma_skb_wrap_cmd(struct sk_buff *skb,
-					    u8 seq, enum mcu_cmd cmd)
+/* Same buffer layout as mt7601u_dma_skb_wrap(), payload is always 4B
+ * aligned here.  Returns the transfer length.
+ */
+static int
+mt7601u_mcu_buf_wrap(struct mt7601u_mcu_buf *b, u8 seq, enum mcu_cmd cmd)
 {
-	mt7601u_dma_skb_wrap(skb, CPU_TX_PORT, DMA_COMMAND,
-			     MT76_SET(MT_TXD_PKT_INFO_SEQ, seq) |
-			     MT76_SET(MT_TXD_PKT_INFO_TYPE, cmd));
+	u32 info;
+
+	info = MT76_SET(MT_TXD_PKT_INFO_SEQ, seq) |
+		MT76_SET(MT_TXD_PKT_INFO_TYPE, cmd) |
+		MT76_SET(MT_TXD_INFO_LEN, b->len) |
+		MT76_SET(MT_TXD_INFO_D_PORT, CPU_TX_PORT) |
+		MT76_SET(MT_TXD_INFO_TYPE, DMA_COMMAND);
+
+	put_unaligned_le32(info, b->dma.buf);
+	memset(b->dma.buf + MT_DMA_HDR_LEN + b->len, 0, 4);
+
+	return MT_DMA_HDR_LEN + b->len + 4;
 }
 
 static inline void trace_mt_mcu_msg_send_cs(struct mt7601u_dev *dev,
-					    struct sk_buff *skb, bool need_resp)
+					    const u8 *data, int len,
+					    bool need_resp)
 {
 	u32 i, csum = 0;
 
-	for (i = 0; i < skb->len / 4; i++)
-		csum ^= get_unaligned_le32(skb->data + i * 4);
+	for (i = 0; i < len / 4; i++)
+		csum ^= get_unaligned_le32(data + i * 4);
+
+	trace_mt_mcu_msg_send(dev, data, csum, need_resp);
+}
+
+static int __mt7601u_mcu_buf_get(struct mt7601u_mcu *mcu)
+{
+	int idx;
 
-	trace_mt_mcu_msg_send(dev, skb, csum, need_resp);
+	spin_lock_irq(&mcu->lock);
+	idx = find_first_zero_bit(mcu->cmd_buf_used, MT_MCU_CMD_BUFS);
+	if (idx < MT_MCU_CMD_BUFS)
+		__set_bit(idx, mcu->cmd_buf_used);
+	else
+		idx = -1;
+	spin_unlock_irq(&mcu->lock);
+
+	return idx;
 }
 
-static struct sk_buff *
+/* Get a command buffer from the pool, blocks if all are in flight */
+static struct mt7601u_mcu_buf *mt7601u_mcu_buf_get(struct mt7601u_dev *dev)
+{
+	unsigned long tout = msecs_to_jiffies(MT_MCU_RESP_TOUT_MS);
+	struct mt7601u_mcu *mcu = &dev->mcu;
+	int idx;
+
+	idx = __mt7601u_mcu_buf_get(mcu);
+	if (idx < 0) {
+		mcu->stats.buf_waits++;
+
+		if (!wait_event_timeout(mcu->wq,
+					(idx = __mt7601u_mcu_buf_get(mcu)) >= 0,
+					tout)) {
+			dev_err(dev->dev, "Error: out of MCU cmd buffers\n");
+			return NULL;
+		}
+	}
+
+	mcu->stats.buf_gets++;
+	mcu->cmd_buf[idx].len = 0;
+
+	return &mcu->cmd_buf[idx];
+}
+
+static void
+mt7601u_mcu_buf_put(struct mt7601u_dev *dev, struct mt7601u_mcu_buf *b)
+{
+	struct mt7601u_mcu *mcu = &dev->mcu;
+	unsigned long flags;
+
+	spin_lock_irqsave(&mcu->lock, flags);
+	b->owner = NULL;
+	__clear_bit(b - mcu->cmd_buf, mcu->cmd_buf_used);
+	spin_unlock_irqrestore(&mcu->lock, flags);
+
+	wake_up(&mcu->wq);
+}
+
+static struct mt7601u_mcu_buf *
 mt7601u_mcu_msg_alloc(struct mt7601u_dev *dev, const void *data, int len)
 {
-	struct sk_buff *skb;
+	struct mt7601u_mcu_buf *b;
 
 	WARN_ON(len % 4); /* if length is not divisible by 4 we need to pad */
+	if (WARN_ON(len > INBAND_PACKET_MAX_LEN))
+		return NULL;
+
+	b = mt7601u_mcu_buf_get(dev);
+	if (!b)
+		return NULL;
 
-	skb = alloc_skb(len + MT_DMA_HDR_LEN + 4, GFP_KERNEL);
-	skb_reserve(skb, MT_DMA_HDR_LEN);
-	memcpy(skb_put(skb, len), data, len);
+	memcpy(b->dma.buf + MT_DMA_HDR_LEN, data, len);
+	b->len = len;
 
-	return skb;
+	return b;
 }
 
-static int mt7601u_mcu_wait_resp(struct mt7601u_dev *dev, u8 seq)
+static void
+mt7601u_mcu_read_resp_regs(struct mt7601u_mcu_req *req, const u8 *data,
+			   int len)
+{
+	u32 reg, val;
+	int i;
+
+	if (WARN_ON_ONCE(len / 8 < req->rp_len))
+		return;
+
+	for (i = 0; i < req->rp_len; i++) {
+		reg = get_unaligned_le32(data + 8 * i) - req->base;
+		val = get_unaligned_le32(data + 8 * i + 4);
+		WARN_ON_ONCE(req->rp[i].reg != reg);
+		req->rp[i].value = val;
+	}
+}
+
+/* Burst read response starts with the address followed by the values */
+static void
+mt7601u_mcu_read_resp_burst(struct mt7601u_mcu_req *req, const u8 *data,
+			    int len)
+{
+	int i;
+
+	if (WARN_ON_ONCE(len / 4 < req->rp_len + 1))
+		return;
+
+	WARN_ON_ONCE(get_unaligned_le32(data) != req->base);
+	for (i = 0; i < req->rp_len; i++)
+		req->rd[i] = get_unaligned_le32(data + 4 + 4 * i);
+}
+
+/* Note: must be called with mcu->lock held */
+static void
+__mt7601u_mcu_req_put(struct mt7601u_mcu *mcu, struct mt7601u_mcu_req *req)
+{
+	if (!req->timed_out)
+		mcu->inflight--;
+	req->busy = false;
+	req->timed_out = false;
+	req->rp = NULL;
+	req->rd = NULL;
+	req->batch = NULL;
+	wake_up(&mcu->wq);
+}
+
+/* Give up on a command but keep its seq busy, otherwise a late response
+ * could complete (and fill the read buffer of) the next user of the seq.
+ * Slot is released by the response or by the URB kill in cmd_deinit.
+ * Note: must be called with mcu->lock held.
+ */
+static void
+__mt7601u_mcu_req_quarantine(struct mt7601u_mcu *mcu,
+			     struct mt7601u_mcu_req *req)
+{
+	req->timed_out = true;
+	req->rp = NULL;
+	req->rd = NULL;
+	req->batch = NULL;
+	mcu->inflight--;
+	wake_up(&mcu->wq);
+}
+
+static bool mt7601u_mcu_req_done(struct mt7601u_dev *dev, u8 seq, int ret)
+{
+	struct mt7601u_mcu *mcu = &dev->mcu;
+	struct mt7601u_mcu_req *req = &mcu->req[seq];
+	unsigned long flags;
+	bool found = false;
+
+	spin_lock_irqsave(&mcu->lock, flags);
+	if (!req->busy || req->done)
+		goto out;
+
+	found = true;
+
+	/* Waiter is long gone, only free the seq */
+	if (req->timed_out) {
+		mcu->stats.late_resps++;
+		__mt7601u_mcu_req_put(mcu, req);
+		goto out;
+	}
+
+	req->done = true;
+	req->ret = ret;
+
+	/* Nobody waits for async commands, release the slot right away */
+	if (req->async) {
+		if (ret && req->batch && !req->batch->err)
+			req->batch->err = ret;
+		__mt7601u_mcu_req_put(mcu, req);
+	} else {
+		complete(&req->cmpl);
+	}
+out:
+	spin_unlock_irqrestore(&mcu->lock, flags);
+
+	return found;
+}
+
+static void
+mt7601u_mcu_cmd_resp(struct mt7601u_dev *dev, u8 seq, u8 evt,
+		     const u8 *data, int len)
 {
+	struct mt7601u_mcu *mcu = &dev->mcu;
+	struct mt7601u_mcu_req *req = &mcu->req[seq];
+	unsigned long flags;
+	int ret = 0;
+
+	spin_lock_irqsave(&mcu->lock, flags);
+	if (req->busy && req->rp && evt == CMD_DONE)
+		mt7601u_mcu_read_resp_regs(req, data, len);
+	else if (req->busy && req->rd && evt == CMD_DONE)
+		mt7601u_mcu_read_resp_burst(req, data, len);
+	spin_unlock_irqrestore(&mcu->lock, flags);
+
+	if (evt == CMD_ERROR)
+		ret = -EIO;
+	else if (evt == CMD_RETRY)
+		ret = -EAGAIN;
+	if (ret)
+		dev_err(dev->dev, "Error: MCU resp evt:%hhx seq:%hhx\n",
+			evt, seq);
+
+	if (!mt7601u_mcu_req_done(dev, seq, ret))
+		dev_err(dev->dev, "Error: MCU resp for unknown seq:%hhx\n",
+			seq);
+}
+
+static void
+mt7601u_mcu_event(struct mt7601u_dev *dev, u8 seq, u8 evt,
+		  const u8 *data, int len)
+{
+	void (*handler)(struct mt7601u_dev *dev, const u8 *data, int len);
+
+	handler = READ_ONCE(dev->mcu.evt_handler[evt]);
+	if (handler)
+		handler(dev, data, len);
+	else
+		dev_dbg(dev->dev, "Unhandled MCU event:%hhx len:%d\n",
+			evt, len);
+
+	/* Note: event may also be the reply to a command */
+	if (seq)
+		mt7601u_mcu_req_done(dev, seq, 0);
+}
+
+static void mt7601u_mcu_resp_complete(struct urb *urb)
+{
+	struct mt7601u_dev *dev = urb->context;
+	struct mt7601u_mcu *mcu = &dev->mcu;
+	u8 *buf = urb->transfer_buffer;
+	int posted, ret;
 	u32 rxfce;
-	int ret, i = 5;
+	u8 seq, evt;
 
-	while (i--) {
-		if (!wait_for_completion_timeout(&dev->mcu.resp_cmpl,
-						 msecs_to_jiffies(300))) {
-			dev_warn(dev->dev, "Warning: %s retrying\n", __func__);
-			continue;
-		}
+	posted = atomic_dec_return(&mcu->resp_posted);
+	if (urb->status && !mt7601u_urb_has_error(urb))
+		return;
 
-		/* Make copies of important data before reusing the urb */
-		rxfce = get_unaligned_le32(dev->mcu.resp.buf);
+	/* Nothing was posted until we resubmit, responses may get stalled */
+	if (!posted)
+		mcu->stats.resp_starved++;
 
-		ret = mt7601u_usb_submit_buf(dev, USB_DIR_IN, MT_EP_IN_CMD_RESP,
-					     &dev->mcu.resp, GFP_KERNEL,
-					     mt7601u_complete_urb,
-					     &dev->mcu.resp_cmpl);
-		if (ret)
-			return ret;
+	if (mt7601u_urb_has_error(urb)) {
+		dev_err(dev->dev, "Error: MCU resp urb failed:%d\n",
+			urb->status);
+		goto resubmit;
+	}
+	if (urb->actual_length < 8)
+		goto resubmit;
+
+	rxfce = get_unaligned_le32(buf);
+	seq = MT76_GET(MT_RX_FCE_INFO_CMD_SEQ, rxfce);
+	evt = MT76_GET(MT_RX_FCE_INFO_EVT_TYPE, rxfce);
+	mcu->stats.evts[evt]++;
+
+	if (evt <= CMD_RETRY)
+		mt7601u_mcu_cmd_resp(dev, seq, evt, buf + 4,
+				     urb->actual_length - 8);
+	else
+		mt7601u_mcu_event(dev, seq, evt, buf + 4,
+				  urb->actual_length - 8);
+resubmit:
+	if (test_bit(MT7601U_STATE_REMOVED, &dev->state))
+		return;
+
+	/* URB is already set up, just put it back in the ring */
+	trace_submit_urb(urb);
+	ret = usb_submit_urb(urb, GFP_ATOMIC);
+	if (ret)
+		dev_err(dev->dev, "Error: MCU resp urb resubmit failed:%d\n",
+			ret);
+	else
+		atomic_inc(&mcu->resp_posted);
+}
+
+/* Register handler for unsolicited MCU events of type @evt, pass NULL
+ * handler to unregister.
+ */
+int mt7601u_mcu_register_evt(struct mt7601u_dev *dev, u8 evt,
+			     void (*handler)(struct mt7601u_dev *dev,
+					     const u8 *data, int len))
+{
+	if (evt <= CMD_RETRY || evt >= MT_MCU_EVT_MAX)
+		return -EINVAL;
+
+	WRITE_ONCE(dev->mcu.evt_handler[evt], handler);
+
+	return 0;
+}
+
+static void mt7601u_mcu_out_complete(struct urb *urb)
+{
+	struct mt7601u_mcu_buf *b = urb->context;
+	struct mt7601u_dev *dev = b->dev;
+
+	if (mt7601u_urb_has_error(urb))
+		dev_err(dev->dev, "Error: send MCU cmd failed:%d\n",
+			urb->status);
+
+	/* Response will never come, fail the command now */
+	if (urb->status && b->seq)
+		mt7601u_mcu_req_done(dev, b->seq, urb->status);
+
+	mt7601u_mcu_buf_put(dev, b);
+}
+
+/* Allocate a sequence number, blocks if too many commands are in flight.
+ * Note: must be called with mcu->mutex held.
+ */
+static int mt7601u_mcu_req_get(struct mt7601u_dev *dev, bool async)
+{
+	struct mt7601u_mcu *mcu = &dev->mcu;
+	struct mt7601u_mcu_req *req;
+	int i;
+	u8 seq;
+
+	if (READ_ONCE(mcu->inflight) >= MT_MCU_MAX_INFLIGHT)
+		mcu->stats.window_full++;
+
+	/* Only mutex holder can increase inflight, no need to recheck */
+	if (!wait_event_timeout(mcu->wq,
+				READ_ONCE(mcu->inflight) < MT_MCU_MAX_INFLIGHT,
+				msecs_to_jiffies(MT_MCU_RESP_TOUT_MS))) {
+		dev_err(dev->dev, "Error: MCU command window stuck\n");
+		return -ETIMEDOUT;
+	}
 
-		if (MT76_GET(MT_RX_FCE_INFO_CMD_SEQ, rxfce) == seq &&
-		    MT76_GET(MT_RX_FCE_INFO_EVT_TYPE, rxfce) == CMD_DONE)
-			return 0;
+	spin_lock_irq(&mcu->lock);
 
-		dev_err(dev->dev, "Error: MCU resp evt:%hhx seq:%hhx-%hhx!\n",
-			MT76_GET(MT_RX_FCE_INFO_EVT_TYPE, rxfce),
-			seq, MT76_GET(MT_RX_FCE_INFO_CMD_SEQ, rxfce));
+	for (i = 0; i < MT_MCU_SEQ_MAX; i++) {
+		seq = ++mcu->msg_seq & 0xf;
+		if (seq && !mcu->req[seq].busy)
+			break;
 	}
 
+	/* All free seqs are quarantined, reusing one would let its late
+	 * response complete the wrong command.
+	 */
+	if (!seq || mcu->req[seq].busy) {
+		spin_unlock_irq(&mcu->lock);
+		dev_err(dev->dev, "Error: no MCU seq left, all timed out\n");
+		return -EBUSY;
+	}
+
+	req = &mcu->req[seq];
+	req->busy = true;
+	req->done = false;
+	req->async = async;
+	req->timed_out = false;
+	req->ret = 0;
+	req->owner = current;
+	req->batch = async ? mcu->batch : NULL;
+	req->rp = mcu->rp;
+	req->rd = mcu->rd;
+	req->rp_len = mcu->rp_len;
+	req->base = mcu->base;
+	reinit_completion(&req->cmpl);
+
+	mcu->inflight++;
+	mcu->stats.max_inflight = max_t(u32, mcu->stats.max_inflight,
+					mcu->inflight);
+
+	spin_unlock_irq(&mcu->lock);
+
+	return seq;
+}
+
+static int mt7601u_mcu_wait_resp(struct mt7601u_dev *dev, u8 seq)
+{
+	struct mt7601u_mcu *mcu = &dev->mcu;
+	struct mt7601u_mcu_req *req = &mcu->req[seq];
+	int ret;
+
+	if (!wait_for_completion_timeout(&req->cmpl,
+					 msecs_to_jiffies(MT_MCU_RESP_TOUT_MS)))
+		mcu->stats.timeouts++;
+
+	spin_lock_irq(&mcu->lock);
+	if (req->done) {
+		ret = req->ret;
+		__mt7601u_mcu_req_put(mcu, req);
+	} else {
+		ret = -ETIMEDOUT;
+		__mt7601u_mcu_req_quarantine(mcu, req);
+	}
+	spin_unlock_irq(&mcu->lock);
+
+	if (ret == -ETIMEDOUT)
+		dev_err(dev->dev, "Error: %s seq:%hhx timed out\n",
+			__func__, seq);
+
+	return ret;
+}
+
+/* Note: must be called with mcu->lock held */
+static bool __mt7601u_mcu_ctx_sending(struct mt7601u_mcu *mcu)
+{
+	int i;
+
+	for (i = 0; i < MT_MCU_CMD_BUFS; i++)
+		if (test_bit(i, mcu->cmd_buf_used) &&
+		    mcu->cmd_buf[i].owner == current)
+			return true;
+
+	return false;
+}
+
+/* Note: must be called with mcu->lock held */
+static bool __mt7601u_mcu_ctx_waiting(struct mt7601u_mcu *mcu)
+{
+	struct mt7601u_mcu_req *req;
+	int i;
+
+	for (i = 1; i < MT_MCU_SEQ_MAX; i++) {
+		req = &mcu->req[i];
+		if (req->busy && !req->done && !req->timed_out &&
+		    req->owner == current)
+			return true;
+	}
+
+	return false;
+}
+
+static bool mt7601u_mcu_ctx_idle(struct mt7601u_mcu *mcu)
+{
+	bool idle;
+
+	spin_lock_irq(&mcu->lock);
+	idle = !__mt7601u_mcu_ctx_sending(mcu) &&
+	       !__mt7601u_mcu_ctx_waiting(mcu);
+	spin_unlock_irq(&mcu->lock);
+
+	return idle;
+}
+
+/* Wait until MCU commands sent so far by the current task are completed,
+ * doesn't report errors of async commands.  Used as a barrier before
+ * register accesses since MCU may be touching the same registers.
+ * Note: commands of other tasks are not waited for, ordering against
+ *	 those has to come from the callers' own locking anyway.
+ */
+void mt7601u_mcu_wait_idle(struct mt7601u_dev *dev)
+{
+	struct mt7601u_mcu *mcu = &dev->mcu;
+	struct mt7601u_mcu_req *req;
+	bool stuck;
+	int i;
+
+	if (!READ_ONCE(mcu->inflight) && usb_anchor_empty(&mcu->out_anchor))
+		return;
+
+	if (wait_event_timeout(mcu->wq, mt7601u_mcu_ctx_idle(mcu),
+			       msecs_to_jiffies(MT_MCU_RESP_TOUT_MS)))
+		return;
+
 	dev_err(dev->dev, "Error: %s timed out\n", __func__);
-	return -ETIMEDOUT;
+	mcu->stats.timeouts++;
+
+	/* Kill only our own URBs, commands of other tasks are fine.  Killed
+	 * URBs fail their commands in mt7601u_mcu_out_complete().
+	 */
+	for (i = 0; i < MT_MCU_CMD_BUFS; i++) {
+		spin_lock_irq(&mcu->lock);
+		stuck = test_bit(i, mcu->cmd_buf_used) &&
+			mcu->cmd_buf[i].owner == current;
+		spin_unlock_irq(&mcu->lock);
+
+		if (stuck)
+			usb_kill_urb(mcu->cmd_buf[i].dma.urb);
+	}
+
+	/* Synchronous commands are released by their waiters */
+	spin_lock_irq(&mcu->lock);
+	for (i = 1; i < MT_MCU_SEQ_MAX; i++) {
+		req = &mcu->req[i];
+		if (!req->busy || !req->async || req->timed_out ||
+		    req->owner != current)
+			continue;
+
+		if (req->batch && !req->batch->err)
+			req->batch->err = -ETIMEDOUT;
+		__mt7601u_mcu_req_quarantine(mcu, req);
+	}
+	spin_unlock_irq(&mcu->lock);
+}
+
+/* Wait for the MCU commands sent so far by the current task and return
+ * the first error reported by an async command of @batch.
+ * Note: @batch must not be used by async commands after this returns.
+ */
+int mt7601u_mcu_sync(struct mt7601u_dev *dev, struct mt7601u_mcu_batch *batch)
+{
+	struct mt7601u_mcu *mcu = &dev->mcu;
+	int ret;
+
+	mt7601u_mcu_wait_idle(dev);
+
+	spin_lock_irq(&mcu->lock);
+	ret = batch->err;
+	spin_unlock_irq(&mcu->lock);
+
+	return ret;
 }
 
 static int
-mt7601u_mcu_msg_send(struct mt7601u_dev *dev, struct sk_buff *skb,
-		     enum mcu_cmd cmd, bool wait_resp)
+mt7601u_mcu_submit(struct mt7601u_dev *dev, struct mt7601u_mcu_buf *b,
+		   enum mcu_cmd cmd, u8 seq)
 {
 	struct usb_device *usb_dev = mt7601u_to_usb_dev(dev);
 	unsigned cmd_pipe = usb_sndbulkpipe(usb_dev,
 					    dev->out_eps[MT_EP_OUT_INBAND_CMD]);
-	int sent, ret;
-	u8 seq = 0;
+	struct urb *urb = b->dma.urb;
+	int len, ret;
 
-	if (test_bit(MT7601U_STATE_REMOVED, &dev->state))
-		return 0;
+	len = mt7601u_mcu_buf_wrap(b, seq, cmd);
+	b->seq = seq;
 
-	mutex_lock(&dev->mcu.mutex);
+	spin_lock_irq(&dev->mcu.lock);
+	b->owner = current;
+	spin_unlock_irq(&dev->mcu.lock);
 
-	if (wait_resp)
-		while (!seq)
-			seq = ++dev->mcu.msg_seq & 0xf;
+	usb_fill_bulk_urb(urb, usb_dev, cmd_pipe, b->dma.buf, len,
+			  mt7601u_mcu_out_complete, b);
+	urb->transfer_dma = b->dma.dma;
+	urb->transfer_flags |= URB_NO_TRANSFER_DMA_MAP;
+	usb_anchor_urb(urb, &dev->mcu.out_anchor);
 
-	mt7601u_dma_skb_wrap_cmd(skb, seq, cmd);
+	trace_mt_mcu_msg_send_cs(dev, b->dma.buf, len, seq);
+	trace_submit_urb(urb);
+	ret = usb_submit_urb(urb, GFP_KERNEL);
+	if (ret) {
+		dev_err(dev->dev, "Error: send MCU cmd failed:%d\n", ret);
+		usb_unanchor_urb(urb);
+	}
 
-	if (dev->mcu.resp_cmpl.done)
-		dev_err(dev->dev, "Error: MCU response pre-completed!\n");
+	return ret;
+}
 
-	trace_mt_mcu_msg_send_cs(dev, skb, wait_resp);
-	trace_submit_urb_sync(cmd_pipe, skb->len);
-	ret = usb_bulk_msg(usb_dev, cmd_pipe, skb->data, skb->len, &sent, 500);
+/* Note: must be called with mcu->mutex held, always releases @b.
+ *	 Returns sequence number assigned to the command (0 if no response
+ *	 was requested) or a negative error.
+ */
+static int
+__mt7601u_mcu_msg_send(struct mt7601u_dev *dev, struct mt7601u_mcu_buf *b,
+		       enum mcu_cmd cmd, bool need_resp, bool async)
+{
+	struct mt7601u_mcu *mcu = &dev->mcu;
+	int seq = 0, ret;
+
+	if (need_resp) {
+		seq = mt7601u_mcu_req_get(dev, async);
+		if (seq < 0) {
+			mt7601u_mcu_buf_put(dev, b);
+			return seq;
+		}
+	}
+
+	/* MCU may access registers, make sure posted writes landed */
+	mt7601u_vendor_flush(dev);
+
+	ret = mt7601u_mcu_submit(dev, b, cmd, seq);
 	if (ret) {
-		dev_err(dev->dev, "Error: send MCU cmd failed:%d\n", ret);
-		goto out;
+		mt7601u_mcu_buf_put(dev, b);
+		if (seq) {
+			spin_lock_irq(&mcu->lock);
+			__mt7601u_mcu_req_put(mcu, &mcu->req[seq]);
+			spin_unlock_irq(&mcu->lock);
+		}
+		return ret;
 	}
-	if (sent != skb->len)
-		dev_err(dev->dev, "Error: %s sent != skb->len\n", __func__);
 
-	if (wait_resp)
-		ret = mt7601u_mcu_wait_resp(dev, seq);
-out:
+	mcu->stats.cmds++;
+	if (async)
+		mcu->stats.async++;
+
+	return seq;
+}
+
+static int
+mt7601u_mcu_msg_send(struct mt7601u_dev *dev, struct mt7601u_mcu_buf *b,
+		     enum mcu_cmd cmd, bool wait_resp)
+{
+	int seq;
+
+	if (test_bit(MT7601U_STATE_REMOVED, &dev->state)) {
+		mt7601u_mcu_buf_put(dev, b);
+		return 0;
+	}
+
+	if (mt7601u_wr_batch_owner(dev))
+		mt7601u_wr_batch_flush(dev);
+
+	mutex_lock(&dev->mcu.mutex);
+	seq = __mt7601u_mcu_msg_send(dev, b, cmd, wait_resp, false);
 	mutex_unlock(&dev->mcu.mutex);
 
-	consume_skb(skb);
+	/* Wait outside of the mutex so others can queue their commands */
+	if (seq <= 0)
+		return seq;
 
-	return ret;
+	return mt7601u_mcu_wait_resp(dev, seq);
+}
+
+/* Send a command without waiting for its completion.  Errors are recorded
+ * in @batch and reported by mt7601u_mcu_sync().
+ */
+static int
+mt7601u_mcu_msg_send_async(struct mt7601u_dev *dev, struct mt7601u_mcu_buf *b,
+			   enum mcu_cmd cmd, struct mt7601u_mcu_batch *batch)
+{
+	int seq;
+
+	if (test_bit(MT7601U_STATE_REMOVED, &dev->state)) {
+		mt7601u_mcu_buf_put(dev, b);
+		return 0;
+	}
+
+	if (mt7601u_wr_batch_owner(dev))
+		mt7601u_wr_batch_flush(dev);
+
+	mutex_lock(&dev->mcu.mutex);
+	dev->mcu.batch = batch;
+	seq = __mt7601u_mcu_msg_send(dev, b, cmd, true, true);
+	dev->mcu.batch = NULL;
+	mutex_unlock(&dev->mcu.mutex);
+
+	return seq < 0 ? seq : 0;
 }
 
 static int mt7601u_mcu_function_select(struct mt7601u_dev *dev,
 				       enum mcu_function func, u32 val)
 {
-	struct sk_buff *skb;
+	struct mt7601u_mcu_buf *b;
 	struct {
 		__le32 id;
 		__le32 value;
@@ -163,8 +712,11 @@ static int mt7601u_mcu_function_select(struct mt7601u_dev *dev,
 		.value = cpu_to_le32(val),
 	};
 
-	skb = mt7601u_mcu_msg_alloc(dev, &msg, sizeof(msg));
-	return mt7601u_mcu_msg_send(dev, skb, CMD_FUN_SET_OP, func == 5);
+	b = mt7601u_mcu_msg_alloc(dev, &msg, sizeof(msg));
+	if (!b)
+		return -ENOMEM;
+
+	return mt7601u_mcu_msg_send(dev, b, CMD_FUN_SET_OP, func == 5);
 }
 
 int mt7601u_mcu_tssi_read_kick(struct mt7601u_dev *dev, int use_hvga)
@@ -189,7 +741,7 @@ int mt7601u_mcu_tssi_read_kick(struct mt7601u_dev *dev, int use_hvga)
 int
 mt7601u_mcu_calibrate(struct mt7601u_dev *dev, enum mcu_calibrate cal, u32 val)
 {
-	struct sk_buff *skb;
+	struct mt7601u_mcu_buf *b;
 	struct {
 		__le32 id;
 		__le32 value;
@@ -197,67 +749,305 @@ mt7601u_mcu_calibrate(struct mt7601u_dev *dev, enum mcu_calibrate cal, u32 val)
 		.id = cpu_to_le32(cal),
 		.value = cpu_to_le32(val),
 	};
+	int ret;
+
+	b = mt7601u_mcu_msg_alloc(dev, &msg, sizeof(msg));
+	if (!b)
+		return -ENOMEM;
 
-	skb = mt7601u_mcu_msg_alloc(dev, &msg, sizeof(msg));
-	return mt7601u_mcu_msg_send(dev, skb, CMD_CALIBRATION_OP, true);
+	ret = mt7601u_mcu_msg_send(dev, b, CMD_CALIBRATION_OP, true);
+
+	/* Note: calibration routines program BBP registers themselves */
+	mt7601u_bbp_cache_invalidate(dev);
+
+	return ret;
 }
 
 int mt7601u_write_reg_pairs(struct mt7601u_dev *dev, u32 base,
 			    const struct mt76_reg_pair *data, int n)
 {
 	const int max_vals_per_cmd = INBAND_PACKET_MAX_LEN/8;
-	struct sk_buff *skb;
-	int cnt, i, ret;
+	struct mt7601u_mcu_batch batch = {};
+	struct mt7601u_mcu_buf *b;
+	int cnt, i, err, ret = 0;
 
 	if (!n)
 		return 0;
 
-	cnt = min(max_vals_per_cmd, n);
+	while (n) {
+		cnt = min(max_vals_per_cmd, n);
 
-	skb = alloc_skb(cnt * 8 + MT_DMA_HDR_LEN + 4, GFP_KERNEL);
-	if (!skb)
-		return -ENOMEM;
-	skb_reserve(skb, MT_DMA_HDR_LEN);
+		b = mt7601u_mcu_buf_get(dev);
+		if (!b) {
+			ret = -ENOMEM;
+			break;
+		}
 
-	for (i = 0; i < cnt; i++) {
-		skb_put_le32(skb, base + data[i].reg);
-		skb_put_le32(skb, data[i].value);
+		for (i = 0; i < cnt; i++) {
+			mt7601u_mcu_buf_add_le32(b, base + data[i].reg);
+			mt7601u_mcu_buf_add_le32(b, data[i].value);
+		}
+
+		ret = mt7601u_mcu_msg_send_async(dev, b, CMD_RANDOM_WRITE,
+						 &batch);
+		if (ret)
+			break;
+
+		if (base == MT_MCU_MEMMAP_WLAN)
+			for (i = 0; i < cnt; i++)
+				mt7601u_reg_cache_update(dev, data[i].reg,
+							 data[i].value);
+		else if (base == MT_MCU_MEMMAP_BBP)
+			for (i = 0; i < cnt; i++)
+				mt7601u_bbp_cache_rmw(dev, data[i].reg, 0xff,
+						      data[i].value);
+
+		data += cnt;
+		n -= cnt;
 	}
 
-	ret = mt7601u_mcu_msg_send(dev, skb, CMD_RANDOM_WRITE, cnt == n);
-	if (ret)
-		return ret;
+	/* All chunks are in flight, wait for them only after the last one.
+	 * Sync on errors too, commands in flight point to @batch.
+	 */
+	err = mt7601u_mcu_sync(dev, &batch);
 
-	return mt7601u_write_reg_pairs(dev, base, data + cnt, n - cnt);
+	return ret ? ret : err;
 }
 
 int mt7601u_burst_write_regs(struct mt7601u_dev *dev, u32 offset,
 			     const u32 *data, int n)
 {
 	const int max_regs_per_cmd = INBAND_PACKET_MAX_LEN/4 - 1;
-	struct sk_buff *skb;
-	int cnt, i, ret;
+	struct mt7601u_mcu_batch batch = {};
+	struct mt7601u_mcu_buf *b;
+	int cnt, i, err, ret = 0;
 
 	if (!n)
 		return 0;
 
-	cnt = min(max_regs_per_cmd, n);
+	while (n) {
+		cnt = min(max_regs_per_cmd, n);
 
-	skb = alloc_skb(cnt * 4 + MT_DMA_HDR_LEN + 4, GFP_KERNEL);
-	if (!skb)
-		return -ENOMEM;
-	skb_reserve(skb, MT_DMA_HDR_LEN);
+		b = mt7601u_mcu_buf_get(dev);
+		if (!b) {
+			ret = -ENOMEM;
+			break;
+		}
+
+		mt7601u_mcu_buf_add_le32(b, MT_MCU_MEMMAP_WLAN + offset);
+		for (i = 0; i < cnt; i++)
+			mt7601u_mcu_buf_add_le32(b, data[i]);
+
+		ret = mt7601u_mcu_msg_send_async(dev, b, CMD_BURST_WRITE,
+						 &batch);
+		if (ret)
+			break;
+
+		for (i = 0; i < cnt; i++)
+			mt7601u_reg_cache_update(dev, offset + i * 4, data[i]);
+
+		offset += cnt * 4;
+		data += cnt;
+		n -= cnt;
+	}
+
+	err = mt7601u_mcu_sync(dev, &batch);
+
+	return ret ? ret : err;
+}
+
+/* Firmware computes (reg & ~mask) | value for each entry, so a batch of
+ * masked updates costs one inband packet instead of a read and a write
+ * round trip per register.
+ */
+int mt7601u_mcu_rmw_regs(struct mt7601u_dev *dev, u32 base,
+			 const struct mt76_reg_rmw *data, int n)
+{
+	const int max_vals_per_cmd = INBAND_PACKET_MAX_LEN/12;
+	struct mt7601u_mcu_batch batch = {};
+	struct mt7601u_mcu_buf *b;
+	int cnt, i, err, ret = 0;
+
+	if (!n)
+		return 0;
+
+	while (n) {
+		cnt = min(max_vals_per_cmd, n);
+
+		b = mt7601u_mcu_buf_get(dev);
+		if (!b) {
+			ret = -ENOMEM;
+			break;
+		}
+
+		for (i = 0; i < cnt; i++) {
+			mt7601u_mcu_buf_add_le32(b, base + data[i].reg);
+			mt7601u_mcu_buf_add_le32(b, data[i].mask);
+			mt7601u_mcu_buf_add_le32(b, data[i].value);
+		}
+
+		ret = mt7601u_mcu_msg_send_async(dev, b,
+						 CMD_READ_MODIFY_WRITE, &batch);
+		if (ret)
+			break;
+
+		if (base == MT_MCU_MEMMAP_WLAN)
+			for (i = 0; i < cnt; i++)
+				mt7601u_reg_cache_rmw(dev, data[i].reg,
+						      data[i].mask,
+						      data[i].value);
+		else if (base == MT_MCU_MEMMAP_BBP)
+			for (i = 0; i < cnt; i++)
+				mt7601u_bbp_cache_rmw(dev, data[i].reg,
+						      data[i].mask,
+						      data[i].value);
+
+		dev->mcu.stats.rmw_regs += cnt;
+		data += cnt;
+		n -= cnt;
+	}
+
+	err = mt7601u_mcu_sync(dev, &batch);
+
+	return ret ? ret : err;
+}
+
+/* Send a read command, response will be parsed into @rp (random read) or
+ * @rd (burst read).  Returns sequence number to wait for.
+ */
+static int
+mt7601u_mcu_read_send(struct mt7601u_dev *dev, struct mt7601u_mcu_buf *b,
+		      enum mcu_cmd cmd, struct mt76_reg_pair *rp, u32 *rd,
+		      int n, u32 base)
+{
+	int seq;
+
+	if (test_bit(MT7601U_STATE_REMOVED, &dev->state)) {
+		mt7601u_mcu_buf_put(dev, b);
+		return -ENODEV;
+	}
+
+	if (mt7601u_wr_batch_owner(dev))
+		mt7601u_wr_batch_flush(dev);
+
+	mutex_lock(&dev->mcu.mutex);
+
+	dev->mcu.rp = rp;
+	dev->mcu.rd = rd;
+	dev->mcu.rp_len = n;
+	dev->mcu.base = base;
+
+	seq = __mt7601u_mcu_msg_send(dev, b, cmd, true, false);
+
+	dev->mcu.rp = NULL;
+	dev->mcu.rd = NULL;
+
+	mutex_unlock(&dev->mcu.mutex);
+
+	return seq;
+}
+
+/* Wait for the previous chunk of a read after the next one was sent so
+ * that USB latencies overlap.  Only one extra slot is held at a time to
+ * leave the rest of the window to others.
+ */
+static int mt7601u_mcu_read_wait(struct mt7601u_dev *dev, int *prev, int seq)
+{
+	int ret = 0;
+
+	if (*prev > 0)
+		ret = mt7601u_mcu_wait_resp(dev, *prev);
+	*prev = seq;
+
+	return ret;
+}
+
+/* Note: registers are read in the order given, which makes it possible to
+ *	 pop FIFO-like registers multiple times with a single command.
+ */
+int mt7601u_read_reg_pairs(struct mt7601u_dev *dev, u32 base,
+			   struct mt76_reg_pair *data, int n)
+{
+	const int max_vals_per_cmd = INBAND_PACKET_MAX_LEN/8;
+	struct mt7601u_mcu_buf *b;
+	int cnt, i, seq, prev = 0, err, ret = 0;
+
+	while (n && !ret) {
+		cnt = min(max_vals_per_cmd, n);
+
+		b = mt7601u_mcu_buf_get(dev);
+		if (!b) {
+			ret = -ENOMEM;
+			break;
+		}
+
+		for (i = 0; i < cnt; i++) {
+			mt7601u_mcu_buf_add_le32(b, base + data[i].reg);
+			mt7601u_mcu_buf_add_le32(b, data[i].value);
+		}
+
+		seq = mt7601u_mcu_read_send(dev, b, CMD_RANDOM_READ,
+					    data, NULL, cnt, base);
+		ret = mt7601u_mcu_read_wait(dev, &prev, seq);
+		if (seq < 0)
+			ret = seq;
+
+		data += cnt;
+		n -= cnt;
+	}
+
+	err = mt7601u_mcu_read_wait(dev, &prev, 0);
+	if (!ret)
+		ret = err;
+
+	return ret;
+}
+
+int mt7601u_burst_read_regs(struct mt7601u_dev *dev, u32 offset,
+			    u32 *data, int n)
+{
+	const int max_regs_per_cmd = INBAND_PACKET_MAX_LEN/4 - 1;
+	u32 start = offset, *out = data, gen;
+	struct mt7601u_mcu_buf *b;
+	int cnt, i, seq, prev = 0, err, ret = 0;
+
+	gen = mt7601u_reg_cache_gen(dev);
+
+	while (n && !ret) {
+		cnt = min(max_regs_per_cmd, n);
+
+		b = mt7601u_mcu_buf_get(dev);
+		if (!b) {
+			ret = -ENOMEM;
+			break;
+		}
+
+		mt7601u_mcu_buf_add_le32(b, MT_MCU_MEMMAP_WLAN + offset);
+		mt7601u_mcu_buf_add_le32(b, cnt);
 
-	skb_put_le32(skb, MT_MCU_MEMMAP_WLAN + offset);
-	for (i = 0; i < cnt; i++)
-		skb_put_le32(skb, data[i]);
+		seq = mt7601u_mcu_read_send(dev, b, CMD_BURST_READ, NULL, data,
+					    cnt, MT_MCU_MEMMAP_WLAN + offset);
+		ret = mt7601u_mcu_read_wait(dev, &prev, seq);
+		if (seq < 0)
+			ret = seq;
 
-	ret = mt7601u_mcu_msg_send(dev, skb, CMD_BURST_WRITE, cnt == n);
+		offset += cnt * 4;
+		data += cnt;
+		n -= cnt;
+	}
+
+	err = mt7601u_mcu_read_wait(dev, &prev, 0);
+	if (!ret)
+		ret = err;
 	if (ret)
 		return ret;
 
-	return mt7601u_burst_write_regs(dev, offset + cnt * 4,
-					data + cnt, n - cnt);
+	for (i = 0; out + i < data; i++) {
+		trace_reg_read(dev, start + i * 4, out[i]);
+		mt7601u_reg_cache_fill(dev, start + i * 4, out[i], gen);
+	}
+
+	return 0;
 }
 
 struct mt76_fw_header {
@@ -275,83 +1065,127 @@ struct mt76_fw {
 	u8 ilm[];
 };
 
-static int __mt7601u_dma_fw(struct mt7601u_dev *dev,
-			    const struct mt7601u_dma_buf *dma_buf,
-			    const void *data, u32 len, u32 dst_addr)
+/* Firmware is uploaded via two URB buffers, while one chunk is on the wire
+ * the next one is copied into the other buffer.
+ */
+struct mt7601u_fw_xfer {
+	struct mt7601u_dma_buf buf; /* copy, we need to fake length */
+	struct completion cmpl;
+	u32 len;
+};
+
+/* Wrap the chunk in a TXD header, returns payload length rounded up */
+static u32 mt7601u_dma_fw_prep(struct mt7601u_fw_xfer *x,
+			       const struct mt7601u_dma_buf *dma_buf,
+			       const void *data, u32 len)
 {
-	DECLARE_COMPLETION_ONSTACK(cmpl);
-	struct mt7601u_dma_buf buf = *dma_buf; /* we need to fake length */
 	__le32 reg;
-	u32 val;
-	int ret;
+
+	x->buf = *dma_buf;
+	reinit_completion(&x->cmpl);
 
 	reg = cpu_to_le32(MT76_SET(MT_TXD_INFO_TYPE, DMA_PACKET) |
 			  MT76_SET(MT_TXD_INFO_D_PORT, CPU_TX_PORT) |
 			  MT76_SET(MT_TXD_INFO_LEN, len));
-	memcpy(buf.buf, &reg, sizeof(reg));
-	memcpy(buf.buf + sizeof(reg), data, len);
-	memset(buf.buf + sizeof(reg) + len, 0, 8);
-
-	ret = mt7601u_vendor_single_wr(dev, VEND_WRITE_FCE,
-				       MT_FCE_DMA_ADDR, dst_addr);
-	if (ret)
-		return ret;
-	len = roundup(len, 4);
-	ret = mt7601u_vendor_single_wr(dev, VEND_WRITE_FCE,
-				       MT_FCE_DMA_LEN, len << 16);
-	if (ret)
-		return ret;
-
-	buf.len = MT_DMA_HDR_LEN + len + 4;
-	ret = mt7601u_usb_submit_buf(dev, USB_DIR_OUT, MT_EP_OUT_INBAND_CMD,
-				     &buf, GFP_KERNEL,
-				     mt7601u_complete_urb, &cmpl);
-	if (ret)
-		return ret;
-
-	if (!wait_for_completion_timeout(&cmpl, msecs_to_jiffies(1000))) {
-		dev_err(dev->dev, "Error: firmware upload timed out\n");
-		usb_kill_urb(buf.urb);
-		return -ETIMEDOUT;
-	}
+	memcpy(x->buf.buf, &reg, sizeof(reg));
+	memcpy(x->buf.buf + sizeof(reg), data, len);
+	memset(x->buf.buf + sizeof(reg) + len, 0, 8);
 
-	val = mt7601u_rr(dev, MT_TX_CPU_FROM_FCE_CPU_DESC_IDX);
-	val++;
-	mt7601u_wr(dev, MT_TX_CPU_FROM_FCE_CPU_DESC_IDX, val);
+	x->len = roundup(len, 4);
+	x->buf.len = MT_DMA_HDR_LEN + x->len + 4;
 
-	return 0;
+	return x->len;
 }
 
 static int
 mt7601u_dma_fw(struct mt7601u_dev *dev, struct mt7601u_dma_buf *dma_buf,
 	       const void *data, int len, u32 dst_addr)
 {
-	int n, ret;
+	struct mt7601u_fw_xfer x[2];
+	struct mt7601u_fw_xfer *cur, *next;
+	u32 desc_idx;
+	int i, n, ret;
 
 	if (len == 0)
 		return 0;
 
+	init_completion(&x[0].cmpl);
+	init_completion(&x[1].cmpl);
+
+	/* Only we move the CPU index, no need to read it back every time */
+	desc_idx = mt7601u_rr(dev, MT_TX_CPU_FROM_FCE_CPU_DESC_IDX);
+
 	n = min(MCU_FW_URB_MAX_PAYLOAD, len);
-	ret = __mt7601u_dma_fw(dev, dma_buf, data, n, dst_addr);
-	if (ret)
-		return ret;
+	mt7601u_dma_fw_prep(&x[0], &dma_buf[0], data, n);
+
+	for (i = 0; len; i++) {
+		cur = &x[i & 1];
+		next = &x[!(i & 1)];
+
+		/* Note: FCE has a single descriptor (max count is 1), so
+		 *	 address and length can only be set up for the next
+		 *	 chunk after the current one was consumed.
+		 */
+		ret = mt7601u_vendor_single_wr(dev, VEND_WRITE_FCE,
+					       MT_FCE_DMA_ADDR, dst_addr);
+		if (ret)
+			return ret;
+		ret = mt7601u_vendor_single_wr(dev, VEND_WRITE_FCE,
+					       MT_FCE_DMA_LEN, cur->len << 16);
+		if (ret)
+			return ret;
 
-	if (!mt76_poll_msec(dev, MT_MCU_COM_REG1, BIT(31), BIT(31), 500))
-		return -ETIMEDOUT;
+		ret = mt7601u_usb_submit_buf(dev, USB_DIR_OUT,
+					     MT_EP_OUT_INBAND_CMD, &cur->buf,
+					     GFP_KERNEL, mt7601u_complete_urb,
+					     &cur->cmpl);
+		if (ret)
+			return ret;
+
+		if (len > n)
+			mt7601u_dma_fw_prep(next, &dma_buf[!(i & 1)], data + n,
+					    min(MCU_FW_URB_MAX_PAYLOAD,
+						len - n));
 
-	return mt7601u_dma_fw(dev, dma_buf, data + n, len - n, dst_addr + n);
+		if (!wait_for_completion_timeout(&cur->cmpl,
+						 msecs_to_jiffies(1000))) {
+			dev_err(dev->dev, "Error: firmware upload timed out\n");
+			usb_kill_urb(cur->buf.urb);
+			return -ETIMEDOUT;
+		}
+		if (mt7601u_urb_has_error(cur->buf.urb))
+			return -EIO;
+
+		mt7601u_wr(dev, MT_TX_CPU_FROM_FCE_CPU_DESC_IDX, ++desc_idx);
+
+		if (!mt76_poll(dev, MT_MCU_COM_REG1, BIT(31), BIT(31),
+			       500 * USEC_PER_MSEC))
+			return -ETIMEDOUT;
+
+		dev->mcu.stats.fw_chunks++;
+		data += n;
+		dst_addr += n;
+		len -= n;
+		n = min(MCU_FW_URB_MAX_PAYLOAD, len);
+	}
+
+	return 0;
 }
 
 static int
 mt7601u_upload_firmware(struct mt7601u_dev *dev, const struct mt76_fw *fw)
 {
-	struct mt7601u_dma_buf dma_buf;
+	struct mt7601u_dma_buf dma_buf[2] = {};
+	ktime_t start = ktime_get();
 	void *ivb;
 	u32 ilm_len, dlm_len;
-	int i, ret;
+	int ret;
+
+	dev->mcu.stats.fw_chunks = 0;
 
 	ivb = kmemdup(fw->ivb, sizeof(fw->ivb), GFP_KERNEL);
-	if (!ivb || mt7601u_usb_alloc_buf(dev, MCU_FW_URB_SIZE, &dma_buf)) {
+	if (!ivb || mt7601u_usb_alloc_buf(dev, MCU_FW_URB_SIZE, &dma_buf[0]) ||
+	    mt7601u_usb_alloc_buf(dev, MCU_FW_URB_SIZE, &dma_buf[1])) {
 		ret = -ENOMEM;
 		goto error;
 	}
@@ -359,13 +1193,13 @@ mt7601u_upload_firmware(struct mt7601u_dev *dev, const struct mt76_fw *fw)
 	ilm_len = le32_to_cpu(fw->hdr.ilm_len) - sizeof(fw->ivb);
 	dev_dbg(dev->dev, "loading FW - ILM %u + IVB %lu\n",
 		ilm_len, sizeof(fw->ivb));
-	ret = mt7601u_dma_fw(dev, &dma_buf, fw->ilm, ilm_len, sizeof(fw->ivb));
+	ret = mt7601u_dma_fw(dev, dma_buf, fw->ilm, ilm_len, sizeof(fw->ivb));
 	if (ret)
 		goto error;
 
 	dlm_len = le32_to_cpu(fw->hdr.dlm_len);
 	dev_dbg(dev->dev, "loading FW - DLM %u\n", dlm_len);
-	ret = mt7601u_dma_fw(dev, &dma_buf, fw->ilm + ilm_len,
+	ret = mt7601u_dma_fw(dev, dma_buf, fw->ilm + ilm_len,
 			     dlm_len, MT_MCU_DLM_OFFSET);
 	if (ret)
 		goto error;
@@ -376,17 +1210,23 @@ mt7601u_upload_firmware(struct mt7601u_dev *dev, const struct mt76_fw *fw)
 		goto error;
 	ret = 0;
 
-	for (i = 100; i && !firmware_running(dev); i--)
-		msleep(10);
-	if (!i) {
+	dev->mcu.stats.fw_upload_us = ktime_us_delta(ktime_get(), start);
+
+	if (!mt76_poll(dev, MT_MCU_COM_REG0, ~0, 1, USEC_PER_SEC)) {
 		ret = -ETIMEDOUT;
 		goto error;
 	}
 
-	dev_dbg(dev->dev, "Firmware running!\n");
+	dev->mcu.stats.fw_boot_us = ktime_us_delta(ktime_get(), start) -
+				    dev->mcu.stats.fw_upload_us;
+	dev_dbg(dev->dev, "Firmware running! upload %uus (%u chunks), "
+		"boot %uus\n", dev->mcu.stats.fw_upload_us,
+		dev->mcu.stats.fw_chunks, dev->mcu.stats.fw_boot_us);
 error:
 	kfree(ivb);
-	mt7601u_usb_free_buf(dev, &dma_buf);
+	/* Note: both buffers are zeroed, freeing unallocated ones is fine */
+	mt7601u_usb_free_buf(dev, &dma_buf[0]);
+	mt7601u_usb_free_buf(dev, &dma_buf[1]);
 
 	return ret;
 }
@@ -476,12 +1316,28 @@ err_inv_fw:
 	return -ENOENT;
 }
 
+/* Every register access waits for own MCU commands (mt7601u_mcu_wait_idle()),
+ * so this must be done before the first one.
+ */
+void mt7601u_mcu_early_init(struct mt7601u_dev *dev)
+{
+	struct mt7601u_mcu *mcu = &dev->mcu;
+	int i;
+
+	mutex_init(&mcu->mutex);
+	spin_lock_init(&mcu->lock);
+	init_waitqueue_head(&mcu->wq);
+	init_usb_anchor(&mcu->out_anchor);
+	for (i = 0; i < ARRAY_SIZE(mcu->req); i++)
+		init_completion(&mcu->req[i].cmpl);
+	/* No command buffers until mt7601u_mcu_cmd_init() */
+	bitmap_fill(mcu->cmd_buf_used, MT_MCU_CMD_BUFS);
+}
+
 int mt7601u_mcu_init(struct mt7601u_dev *dev)
 {
 	int ret;
 
-	mutex_init(&dev->mcu.mutex);
-
 	ret = mt7601u_load_firmware(dev);
 	if (ret)
 		return ret;
@@ -491,33 +1347,100 @@ int mt7601u_mcu_init(struct mt7601u_dev *dev)
 	return 0;
 }
 
+static void mt7601u_mcu_cmd_bufs_free(struct mt7601u_dev *dev)
+{
+	struct mt7601u_mcu *mcu = &dev->mcu;
+	int i;
+
+	spin_lock_irq(&mcu->lock);
+	bitmap_fill(mcu->cmd_buf_used, MT_MCU_CMD_BUFS);
+	spin_unlock_irq(&mcu->lock);
+
+	for (i = 0; i < MT_MCU_CMD_BUFS; i++)
+		mt7601u_usb_free_buf(dev, &mcu->cmd_buf[i].dma);
+}
+
+static int mt7601u_mcu_cmd_bufs_alloc(struct mt7601u_dev *dev)
+{
+	struct mt7601u_mcu *mcu = &dev->mcu;
+	int i;
+
+	for (i = 0; i < MT_MCU_CMD_BUFS; i++) {
+		mcu->cmd_buf[i].dev = dev;
+		if (mt7601u_usb_alloc_buf(dev, MCU_CMD_BUF_SIZE,
+					  &mcu->cmd_buf[i].dma)) {
+			mt7601u_mcu_cmd_bufs_free(dev);
+			return -ENOMEM;
+		}
+	}
+
+	spin_lock_irq(&mcu->lock);
+	bitmap_zero(mcu->cmd_buf_used, MT_MCU_CMD_BUFS);
+	spin_unlock_irq(&mcu->lock);
+
+	return 0;
+}
+
+static void mt7601u_mcu_resp_free(struct mt7601u_dev *dev)
+{
+	int i;
+
+	for (i = 0; i < MT_MCU_RESP_URBS; i++)
+		usb_kill_urb(dev->mcu.resp[i].urb);
+	for (i = 0; i < MT_MCU_RESP_URBS; i++)
+		mt7601u_usb_free_buf(dev, &dev->mcu.resp[i]);
+	atomic_set(&dev->mcu.resp_posted, 0);
+}
+
 int mt7601u_mcu_cmd_init(struct mt7601u_dev *dev)
 {
-	int ret;
+	struct mt7601u_mcu *mcu = &dev->mcu;
+	int i, ret;
 
-	ret = mt7601u_mcu_function_select(dev, Q_SELECT, 1);
+	ret = mt7601u_mcu_cmd_bufs_alloc(dev);
 	if (ret)
 		return ret;
 
-	init_completion(&dev->mcu.resp_cmpl);
-	if (mt7601u_usb_alloc_buf(dev, MCU_RESP_URB_SIZE, &dev->mcu.resp)) {
-		mt7601u_usb_free_buf(dev, &dev->mcu.resp);
-		return -ENOMEM;
-	}
+	ret = mt7601u_mcu_function_select(dev, Q_SELECT, 1);
+	if (ret)
+		goto err_bufs;
 
-	ret = mt7601u_usb_submit_buf(dev, USB_DIR_IN, MT_EP_IN_CMD_RESP,
-				     &dev->mcu.resp, GFP_KERNEL,
-				     mt7601u_complete_urb, &dev->mcu.resp_cmpl);
-	if (ret) {
-		mt7601u_usb_free_buf(dev, &dev->mcu.resp);
-		return ret;
+	for (i = 0; i < MT_MCU_RESP_URBS; i++) {
+		if (mt7601u_usb_alloc_buf(dev, MCU_RESP_URB_SIZE,
+					  &mcu->resp[i])) {
+			ret = -ENOMEM;
+			goto err;
+		}
+
+		ret = mt7601u_usb_submit_buf(dev, USB_DIR_IN, MT_EP_IN_CMD_RESP,
+					     &mcu->resp[i], GFP_KERNEL,
+					     mt7601u_mcu_resp_complete, dev);
+		if (ret)
+			goto err;
+		atomic_inc(&mcu->resp_posted);
 	}
 
 	return 0;
+err:
+	mt7601u_mcu_resp_free(dev);
+err_bufs:
+	usb_kill_anchored_urbs(&mcu->out_anchor);
+	mt7601u_mcu_cmd_bufs_free(dev);
+	return ret;
 }
 
 void mt7601u_mcu_cmd_deinit(struct mt7601u_dev *dev)
 {
-	usb_kill_urb(dev->mcu.resp.urb);
-	mt7601u_usb_free_buf(dev, &dev->mcu.resp);
+	int i;
+
+	for (i = 0; i < MT_MCU_RESP_URBS; i++)
+		usb_kill_urb(dev->mcu.resp[i].urb);
+	usb_kill_anchored_urbs(&dev->mcu.out_anchor);
+
+	/* No more responses will come, fail whatever is still waiting */
+	for (i = 1; i < MT_MCU_SEQ_MAX; i++)
+		mt7601u_mcu_req_done(dev, i, -ENODEV);
+
+	mt7601u_mcu_resp_free(dev);
+	mt7601u_mcu_cmd_bufs_free(dev);
 }
@@ -81,9 +81,16 @@ enum mcu_calibrate {
 	MCU_CAL_TXDCOC,
 };
 
+void mt7601u_mcu_early_init(struct mt7601u_dev *dev);
 int mt7601u_mcu_init(struct mt7601u_dev *dev);
 int mt7601u_mcu_cmd_init(struct mt7601u_dev *dev);
 void mt7601u_mcu_cmd_deinit(struct mt7601u_dev *dev);
+void mt7601u_mcu_wait_idle(struct mt7601u_dev *dev);
+int mt7601u_mcu_sync(struct mt7601u_dev *dev,
+		     struct mt7601u_mcu_batch *batch);
+int mt7601u_mcu_register_evt(struct mt7601u_dev *dev, u8 evt,
+			     void (*handler)(struct mt7601u_dev *dev,
+					     const u8 *data, int len));
 
 int
 mt7601u_mcu_calibrate(struct mt7601u_dev *dev, enum mcu_calibrate cal, u32 val);
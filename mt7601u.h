@@ -36,6 +36,10 @@
 
 #define MT7601U_VENDOR_REQ_MAX_RETRY	10
 #define MT7601U_VENDOR_REQ_TOUT_MS	300
+/* Consecutive failed vendor requests after which device is reset */
+#define MT7601U_VENDOR_BREAKER_THRESH	3
+/* Time after which an open breaker lets one request through */
+#define MT7601U_VENDOR_BREAKER_COOLDOWN	HZ
 
 #define MT_BBP_REG_VERSION		0x00
 
@@ -46,13 +50,112 @@ struct mt7601u_dma_buf {
 	size_t len;
 };
 
+/* Number of response URBs kept posted on the command response endpoint */
+#define MT_MCU_RESP_URBS	4
+/* Event type is a 4 bit field of FCE info */
+#define MT_MCU_EVT_MAX		16
+
+/* Number of preallocated MCU command buffers */
+#define MT_MCU_CMD_BUFS		16
+
+/* Max number of MCU commands waiting for response at the same time */
+#define MT_MCU_MAX_INFLIGHT	8
+/* Command sequence numbers are 4 bit, 0 means no response is expected */
+#define MT_MCU_SEQ_MAX		16
+
+/* First error of the async commands sent by one caller, see
+ * mt7601u_mcu_sync().
+ */
+struct mt7601u_mcu_batch {
+	int err;
+};
+
+struct mt7601u_mcu_req {
+	struct completion cmpl;
+	int ret;
+	bool busy;
+	bool done;
+	bool async;
+	/* Waiter gave up, seq is held until the response or URB kill */
+	bool timed_out;
+	struct task_struct *owner;
+	struct mt7601u_mcu_batch *batch;
+
+	struct mt76_reg_pair *rp;
+	u32 *rd;
+	int rp_len;
+	u32 base;
+};
+
+struct mt7601u_dev;
+
+struct mt7601u_mcu_buf {
+	struct mt7601u_dma_buf dma;
+	struct mt7601u_dev *dev;
+	u32 len; /* of the payload, without DMA header */
+	u8 seq;
+	struct task_struct *owner; /* set while the URB is in flight */
+};
+
+struct mt7601u_mcu_stats {
+	u64 cmds;
+	u64 async;
+	u32 window_full;
+	u32 timeouts;
+	u32 late_resps;
+	u32 max_inflight;
+
+	u32 evts[MT_MCU_EVT_MAX];
+	u32 resp_starved;
+
+	u64 buf_gets;
+	u32 buf_waits;
+	u32 init_buf_gets;
+	u32 cal_buf_gets;
+
+	u32 phy_init_us;
+	u32 phy_init_cmds;
+	u32 fw_upload_us;
+	u32 fw_boot_us;
+	u32 fw_chunks;
+
+	u64 rmw_regs;
+};
+
 struct mt7601u_mcu {
+	/* Serializes submission (seq allocation, URB order), not completion */
 	struct mutex mutex;
 
 	u8 msg_seq;
 
-	struct mt7601u_dma_buf resp;
-	struct completion resp_cmpl;
+	/* Protects req[], cmd_buf_used, buffer owners and inflight,
+	 * taken from URB callbacks.
+	 */
+	spinlock_t lock;
+	int inflight;
+	wait_queue_head_t wq;
+	struct usb_anchor out_anchor;
+	struct mt7601u_mcu_req req[MT_MCU_SEQ_MAX];
+	struct mt7601u_mcu_buf cmd_buf[MT_MCU_CMD_BUFS];
+	DECLARE_BITMAP(cmd_buf_used, MT_MCU_CMD_BUFS);
+
+	struct mt7601u_dma_buf resp[MT_MCU_RESP_URBS];
+	atomic_t resp_posted;
+	/* Handlers of unsolicited MCU events, called in atomic context */
+	void (*evt_handler[MT_MCU_EVT_MAX])(struct mt7601u_dev *dev,
+					     const u8 *data, int len);
+
+	/* Register read buffer for the next command (@rp for random reads,
+	 * @rd for burst reads) and batch of the next async command,
+	 * protected by mutex.
+	 */
+	struct mt76_reg_pair *rp;
+	u32 *rd;
+	int rp_len;
+	u32 base;
+	struct mt7601u_mcu_batch *batch;
+
+	struct mt7601u_mcu_stats stats;
 };
 
 enum {
@@ -62,7 +165,6 @@ enum {
 	MT7601U_STATE_MCU_RUNNING,
 	MT7601U_STATE_SCANNING,
 	MT7601U_STATE_READING_STATS,
-	MT7601U_STATE_MORE_STATS,
 };
 
 struct mac_stats {
@@ -71,6 +173,211 @@ struct mac_stats {
 	u64 aggr_stat[2];
 	u64 aggr_n[32];
 	u64 zero_len_del[2];
+
+	/* time it took to read the counters the last time */
+	u32 work_us;
+};
+
+/* Note: depth of the TX status FIFO is not documented, 16 is a guess based
+ *	 on other Ralink chips.  A batch must be able to hold more entries
+ *	 than that to tell a full FIFO from a busy one.
+ */
+#define MT_TX_STAT_FIFO_DEPTH	16
+/* Statuses per batch, one MCU command (two with EXT_FIFO) */
+#define MT_TX_STAT_BATCH	24
+
+/* Bounds for the delay between TX status polls */
+#define MT_TX_STAT_MIN_DELAY_US	1000
+#define MT_TX_STAT_MAX_DELAY_US	20000
+/* Number of empty polls after which pending statuses are considered lost */
+#define MT_TX_STAT_MAX_IDLE	4
+/* Max number of subframe statuses reported to mac80211 as one A-MPDU */
+#define MT_TX_STAT_MAX_AMPDU	32
+
+/* Number of driver-owned MAC registers kept in the shadow cache */
+#define MT_REG_CACHE_SIZE	64
+#define MT_BBP_CACHE_SIZE	256
+
+struct mt7601u_reg_cache_stats {
+	u64 reads;
+	u64 hits;
+	u64 writes;
+	u64 skipped;
+	u64 resyncs;
+	u64 stale;
+};
+
+struct mt7601u_posted_stats {
+	u64 posted;
+	u64 flushes;
+	u64 replayed;
+	u64 errors;
+	u64 lat_total_us;
+	u32 lat_max_us;
+};
+
+/* Register polling - first sleep and max sleep between reads */
+#define MT_POLL_MIN_DELAY_US		10
+#define MT_POLL_MAX_DELAY_US		1000
+#define MT_POLL_MAX_DELAY_MSEC_US	10000
+#define MT_POLL_MIN_READS		20
+/* Number of call sites of mt76_poll*() tracked for profiling */
+#define MT_POLL_SITES			24
+
+struct mt7601u_poll_stat {
+	unsigned long caller;
+	u32 offset;
+	u32 calls;
+	u64 reads;
+	u64 wait_us;
+	u32 max_us;
+	u32 timeouts;
+};
+
+enum mt7601u_vend_type {
+	MT_VEND_TYPE_READ,
+	MT_VEND_TYPE_WRITE,
+	MT_VEND_TYPE_FCE,
+	MT_VEND_TYPE_DEV_MODE,
+	MT_VEND_TYPE_OTHER,
+	__MT_VEND_TYPE_MAX,
+};
+
+/* Priority classes of register I/O, lower value goes first */
+enum mt7601u_io_prio {
+	MT_IO_PRIO_DATAPATH,
+	MT_IO_PRIO_NORMAL,
+	MT_IO_PRIO_BULK,
+	__MT_IO_PRIO_MAX,
+};
+
+/* log2 buckets of latency in us, last one catches everything above */
+#define MT_USB_HIST_BUCKETS	20
+
+struct mt7601u_usb_stats {
+	u64 reqs[__MT_VEND_TYPE_MAX];
+	u32 lat[__MT_VEND_TYPE_MAX][MT_USB_HIST_BUCKETS];
+	u32 retries[MT7601U_VENDOR_REQ_MAX_RETRY + 1];
+	u32 timeouts;
+	u32 failures;
+	u32 rejected;
+	u32 breaker_trips;
+	u64 lock_wait_us;
+	u32 lock_wait[MT_USB_HIST_BUCKETS];
+	u64 prio_reqs[__MT_IO_PRIO_MAX];
+	u64 prio_wait_us[__MT_IO_PRIO_MAX];
+	u32 prio_max_us[__MT_IO_PRIO_MAX];
+};
+
+struct mt76_reg_pair {
+	u32 reg;
+	u32 value;
+};
+
+struct mt76_reg_rmw {
+	u32 reg;
+	u32 mask;
+	u32 value;
+};
+
+/* Max number of writes recorded in a batch before it's flushed */
+#define MT_WR_BATCH_MAX		48
+/* Number of call sites of mt7601u_wr_batch_begin() tracked for stats */
+#define MT_WR_BATCH_SITES	16
+
+/* USB transfers (vendor requests and MCU commands) and latency per PHY
+ * operation
+ */
+enum mt7601u_xfer_op {
+	MT_XFER_CHAN_SWITCH,
+	MT_XFER_TEMP_COMP,
+	MT_XFER_FREQ_CAL,
+	__MT_XFER_MAX,
+};
+
+struct mt7601u_xfer_stat {
+	u32 runs;
+	u32 last;
+	u64 total;
+	u32 last_us;
+	u64 total_us;
+};
+
+struct mt7601u_cal_cache_stats {
+	u32 hits;
+	u32 misses;
+	u32 cal_us;
+	u64 saved_us;
+};
+
+/* Max number of registers read by mt7601u_rr_bench() */
+#define MT_RD_BENCH_MAX		256
+
+enum mt7601u_rd_mech {
+	MT_RD_SINGLE,
+	MT_RD_VEND_BULK,
+	MT_RD_MCU_RANDOM,
+	MT_RD_MCU_BURST,
+	__MT_RD_MAX,
+};
+
+struct mt7601u_rd_bench {
+	int n;
+	u32 us[__MT_RD_MAX];
+};
+
+/* Max number of registers written by mt7601u_wr_bench() */
+#define MT_WR_BENCH_MAX		256
+
+enum mt7601u_wr_mech {
+	MT_WR_SPLIT,
+	MT_WR_MULTI,
+	__MT_WR_MAX,
+};
+
+struct mt7601u_wr_bench {
+	int n;
+	u32 us[__MT_WR_MAX];
+	u32 xfers[__MT_WR_MAX];
+
+	/* HW init, done with the write path picked at probe */
+	u32 init_us;
+	u64 init_xfers;
+	u64 init_wrs;
+};
+
+struct mt7601u_wr_batch_stat {
+	unsigned long caller;
+	u32 commits;
+	u64 writes;
+	u64 xfers;
+};
+
+/* Default HT fallback - one MCS down with every retry */
+#define MT_HT_FBK_CFG0_DEFAULT	0x65432100
+
+/* PKT_ID 0 disables status reporting */
+#define MT_TX_PKTID_MAX		15
+
+struct mt7601u_txs_stats {
+	u64 polls;
+	u64 empty_polls;
+	u64 kicks;
+	u64 statuses;
+	u64 usb_xfers;
+	u64 batch_errors;
+	u64 fifo_full;
+	u64 lost;
+	u64 drain_us;
+
+	/* EXT_FIFO retries vs PKT_ID guess */
+	u64 ext_statuses;
+	u64 pktid_stale;
+	u64 ext_retries;
+	u64 pktid_retries;
+	u64 retry_match;
+	u64 retry_ext_more;
+	u64 retry_ext_less;
 };
 
 #define N_RX_ENTRIES	64
@@ -116,12 +423,21 @@ struct mt7601u_dev {
 	struct mutex mutex;
 
 	unsigned long wcid_mask[N_WCIDS / BITS_PER_LONG];
+	/* stations in wcid[], written under mutex */
+	u8 n_stas;
 
 	struct cfg80211_chan_def chandef;
 	struct ieee80211_supported_band *sband_2g;
 
 	struct mt7601u_mcu mcu;
 
+	/* Second stage of probe (HW bring-up), init_ret is valid once
+	 * init_done is completed
+	 */
+	struct work_struct init_work;
+	struct completion init_done;
+	int init_ret;
+
 	struct delayed_work cal_work;
 	struct delayed_work mac_work;
 
@@ -146,7 +462,6 @@ struct mt7601u_dev {
 	spinlock_t rx_lock;
 	struct tasklet_struct rx_tasklet;
 	struct mt7601u_rx_queue rx_q;
-	atomic_t avg_ampdu_len;
 
 	/* Beacon monitoring stuff */
 	u8 bssid[ETH_ALEN];
@@ -174,6 +489,40 @@ struct mt7601u_dev {
 
 	struct mac_stats stats;
 
+	/* TX status polling, protected by tx_lock.  tx_stat_ext only changes
+	 * while the device is stopped.
+	 */
+	u8 tx_stat_batch;
+	u8 tx_stat_ext;
+	u32 tx_stat_pending;
+	u32 tx_stat_delay;
+	u8 tx_stat_idle;
+	/* Early poll already requested in this poll cycle */
+	bool tx_stat_kicked;
+	ktime_t tx_stat_last;
+	struct mt7601u_txs_stats txs_stats;
+
+	/* HT fallback table programmed to the HW and the one requested by
+	 * rate control, protected by lock.
+	 */
+	u32 ht_fbk;
+	u32 ht_fbk_req;
+	struct work_struct fbk_work;
+
+	/* PKT_ID allocation for EXT_FIFO mode, protected by lock.  @users
+	 * counts frames sent with the id whose status wasn't seen yet, @prev
+	 * is the id allocated right before, @ht_fbk the fallback table
+	 * programmed when the frame was queued.
+	 */
+	u8 tx_pktid_last;
+	struct {
+		u8 rate;
+		bool is_probe;
+		u8 users;
+		u8 prev;
+		u32 ht_fbk;
+	} tx_pktid[MT_TX_PKTID_MAX + 1];
+
 	s8 avg_rssi;
 
 	struct mt7601u_eeprom_params *ee;
@@ -189,6 +538,84 @@ struct mt7601u_dev {
 	const u16 *beacon_offsets;
 
 	struct mutex vendor_req_mutex;
+	/* bounce buffer and control transfer stats, protected by
+	 * vendor_req_mutex
+	 */
+	void *vend_buf;
+	u64 vend_reqs;
+	struct mt7601u_usb_stats usb_stats;
+	/* I/O priority - tasks which currently own datapath/bulk class and
+	 * number of requests waiting for vendor_req_mutex in each class
+	 */
+	struct task_struct *io_owner[__MT_IO_PRIO_MAX];
+	atomic_t io_waiting[__MT_IO_PRIO_MAX];
+	wait_queue_head_t io_wq;
+
+	/* circuit breaker - once open requests fail until the device is reset
+	 * or a trial request after the cooldown succeeds.  Only armed once
+	 * HW init is done, probe failures are reported as such.
+	 */
+	u8 vend_breaker_thresh;
+	u8 vend_fail_streak;
+	bool vend_breaker_open;
+	unsigned long vend_breaker_since;
+	/* 32-bit register writes in a single control transfer */
+	bool vend_multi_wr;
+	u64 vend_wrs;
+
+	/* Posted register writes, list protected by vendor_req_mutex,
+	 * all stats by posted_lock.
+	 */
+	struct usb_anchor posted_anchor;
+	struct list_head posted_wrs;
+	spinlock_t posted_lock;
+	struct mt7601u_posted_stats posted_stats;
+
+	/* Shadow of driver-owned MAC registers, protected by reg_cache_lock */
+	spinlock_t reg_cache_lock;
+	u8 reg_cache_en;
+	u32 reg_cache[MT_REG_CACHE_SIZE];
+	DECLARE_BITMAP(reg_cache_valid, MT_REG_CACHE_SIZE);
+	u32 reg_cache_gen;
+	struct mt7601u_reg_cache_stats reg_cache_stats;
+	/* Shadow of BBP registers, also protected by reg_cache_lock */
+	u8 bbp_cache[MT_BBP_CACHE_SIZE];
+	DECLARE_BITMAP(bbp_cache_valid, MT_BBP_CACHE_SIZE);
+	struct mt7601u_reg_cache_stats bbp_cache_stats;
+
+	/* Register write batch, only the owner task may touch it */
+	struct mt7601u_wr_batch {
+		struct task_struct *owner;
+		unsigned long caller;
+		u32 writes;
+		u32 packets; /* USB transfers spent on flushing the batch */
+		int n;
+		struct mt76_reg_pair regs[MT_WR_BATCH_MAX];
+	} wr_batch;
+	struct mt7601u_wr_batch_stat wr_batch_stats[MT_WR_BATCH_SITES];
+
+	/* mt7601u_rr_bulk() uses MCU burst reads for at least this many
+	 * registers, 0 means never.  Tuned by mt7601u_rr_bench().
+	 */
+	u16 rd_burst_min;
+	struct mt7601u_rd_bench rd_bench;
+	struct mt7601u_wr_bench wr_bench;
+
+	/* Let the MCU do masked updates (CMD_READ_MODIFY_WRITE) */
+	u8 mcu_rmw;
+	/* Access RF registers through the MCU memmap once firmware is up */
+	u8 rf_mcu;
+	struct mt7601u_xfer_stat xfer_stats[__MT_XFER_MAX];
+
+	/* TSSI DC gain calibration reuse across probes, see phy.c */
+	struct mt7601u_cal_cache_stats cal_cache_stats;
+
+	/* Per call site register polling stats, protected by poll_lock */
+	spinlock_t poll_lock;
+	struct mt7601u_poll_stat poll_stats[MT_POLL_SITES];
+	/* Call sites which didn't fit in poll_stats[] */
+	struct mt7601u_poll_stat poll_stats_other;
+
 	struct mutex reg_atomic_mutex;
 	/* TODO: Is this needed? dev->mutex should suffice */
 	struct mutex hw_atomic_mutex;
@@ -237,6 +664,9 @@ struct mt76_wcid {
 	u16 tx_rate;
 	bool tx_rate_set;
 	u8 tx_rate_nss;
+
+	/* running average of A-MPDU length, in 1/16 of a frame */
+	u16 ampdu_len_avg;
 };
 
 struct mt76_vif {
@@ -250,11 +680,6 @@ struct mt76_sta {
 	u16 agg_ssn[IEEE80211_NUM_TIDS];
 };
 
-struct mt76_reg_pair {
-	u32 reg;
-	u32 value;
-};
-
 #define mt76_rr		mt7601u_rr
 #define mt76_wr		mt7601u_wr
 #define mt76_rmw	mt7601u_rmw
@@ -266,11 +691,46 @@ extern const struct ieee80211_ops mt7601u_ops;
 void mt7601u_init_debugfs(struct mt7601u_dev *dev);
 
 u32 mt7601u_rr(struct mt7601u_dev *dev, u32 offset);
+int mt7601u_rr_bulk(struct mt7601u_dev *dev, u32 offset, u32 *out, int n);
+int mt7601u_rr_bench(struct mt7601u_dev *dev, int n);
+int mt7601u_wr_bench(struct mt7601u_dev *dev, int n);
 void mt7601u_wr(struct mt7601u_dev *dev, u32 offset, u32 val);
 u32 mt7601u_rmw(struct mt7601u_dev *dev, u32 offset, u32 mask, u32 val);
 u32 mt7601u_rmc(struct mt7601u_dev *dev, u32 offset, u32 mask, u32 val);
+int mt7601u_mcu_rmw(struct mt7601u_dev *dev, u32 base, u32 offset,
+		    u32 mask, u32 val);
+void mt7601u_rmw_mcu(struct mt7601u_dev *dev, u32 offset, u32 mask, u32 val);
 void mt7601u_wr_copy(struct mt7601u_dev *dev, u32 offset,
 		     const void *data, int len);
+void mt7601u_wr_posted(struct mt7601u_dev *dev, u32 offset, u32 val);
+void mt7601u_vendor_flush(struct mt7601u_dev *dev);
+void mt7601u_wr_batch_begin(struct mt7601u_dev *dev);
+void mt7601u_wr_batch_flush(struct mt7601u_dev *dev);
+void mt7601u_wr_batch_commit(struct mt7601u_dev *dev);
+
+/* Vendor requests and MCU commands issued so far */
+static inline u64 mt7601u_xfers(struct mt7601u_dev *dev)
+{
+	return dev->vend_reqs + dev->mcu.stats.cmds;
+}
+
+static inline bool mt7601u_wr_batch_owner(struct mt7601u_dev *dev)
+{
+	return READ_ONCE(dev->wr_batch.owner) == current;
+}
+
+/* Mark register I/O done by current task as datapath or bulk class */
+static inline void
+mt7601u_io_prio_begin(struct mt7601u_dev *dev, enum mt7601u_io_prio prio)
+{
+	WRITE_ONCE(dev->io_owner[prio], current);
+}
+
+static inline void
+mt7601u_io_prio_end(struct mt7601u_dev *dev, enum mt7601u_io_prio prio)
+{
+	WRITE_ONCE(dev->io_owner[prio], NULL);
+}
 
 int mt7601u_wait_asic_ready(struct mt7601u_dev *dev);
 bool mt76_poll(struct mt7601u_dev *dev, u32 offset, u32 mask, u32 val,
@@ -302,10 +762,24 @@ int mt7601u_write_reg_pairs(struct mt7601u_dev *dev, u32 base,
 			    const struct mt76_reg_pair *data, int len);
 int mt7601u_burst_write_regs(struct mt7601u_dev *dev, u32 offset,
 			     const u32 *data, int n);
+int mt7601u_read_reg_pairs(struct mt7601u_dev *dev, u32 base,
+			   struct mt76_reg_pair *data, int n);
+int mt7601u_burst_read_regs(struct mt7601u_dev *dev, u32 offset,
+			    u32 *data, int n);
+int mt7601u_mcu_rmw_regs(struct mt7601u_dev *dev, u32 base,
+			 const struct mt76_reg_rmw *data, int n);
 void mt7601u_addr_wr(struct mt7601u_dev *dev, const u32 offset, const u8 *addr);
+void mt7601u_reg_cache_update(struct mt7601u_dev *dev, u32 offset, u32 val);
+u32 mt7601u_reg_cache_gen(struct mt7601u_dev *dev);
+void mt7601u_reg_cache_fill(struct mt7601u_dev *dev, u32 offset, u32 val,
+			    u32 gen);
+void mt7601u_reg_cache_rmw(struct mt7601u_dev *dev, u32 offset,
+			   u32 mask, u32 val);
+void mt7601u_reg_cache_invalidate(struct mt7601u_dev *dev);
 
 /* Init */
 struct mt7601u_dev *mt7601u_alloc_device(struct device *dev);
+int mt7601u_init_early(struct mt7601u_dev *dev);
 int mt7601u_init_hardware(struct mt7601u_dev *dev);
 int mt7601u_register_device(struct mt7601u_dev *dev);
 void mt7601u_cleanup(struct mt7601u_dev *dev);
@@ -313,7 +787,10 @@ void mt7601u_cleanup(struct mt7601u_dev *dev);
 u8 mt7601u_bbp_rr(struct mt7601u_dev *dev, u8 offset);
 void mt7601u_bbp_wr(struct mt7601u_dev *dev, u8 offset, u8 val);
 u8 mt7601u_bbp_rmw(struct mt7601u_dev *dev, u8 offset, u8 mask, u8 val);
+void mt7601u_bbp_rmw_mcu(struct mt7601u_dev *dev, u8 offset, u8 mask, u8 val);
 u8 mt7601u_bbp_rmc(struct mt7601u_dev *dev, u8 offset, u8 mask, u8 val);
+void mt7601u_bbp_cache_rmw(struct mt7601u_dev *dev, u8 offset, u8 mask, u8 val);
+void mt7601u_bbp_cache_invalidate(struct mt7601u_dev *dev);
 
 int mt7601u_mac_start(struct mt7601u_dev *dev);
 void mt7601u_mac_stop(struct mt7601u_dev *dev);
@@ -326,6 +803,7 @@ void mt7601u_dma_cleanup(struct mt7601u_dev *dev);
 
 /* PHY */
 int mt7601u_phy_init(struct mt7601u_dev *dev);
+void mt7601u_cal_cache_flush(struct mt7601u_dev *dev);
 void mt7601u_set_rx_path(struct mt7601u_dev *dev, u8 path);
 void mt7601u_set_tx_dac(struct mt7601u_dev *dev, u8 path);
 int mt7601u_bbp_set_bw(struct mt7601u_dev *dev, int bw);
@@ -349,6 +827,9 @@ void
 mt7601u_mac_wcid_setup(struct mt7601u_dev *dev, u8 idx, u8 vif_idx, u8 *mac);
 void mt7601u_mac_set_ampdu_factor(struct mt7601u_dev *dev,
 				  struct ieee80211_sta_ht_cap *cap);
+void mt7601u_mac_set_ht_fbk(struct mt7601u_dev *dev,
+			    const struct ieee80211_sta_rates *rates);
+void mt7601u_mac_fbk_work(struct work_struct *work);
 
 /* TX */
 void mt7601u_tx(struct ieee80211_hw *hw, struct ieee80211_tx_control *control,
@@ -154,11 +154,25 @@ out:
 	trace_rf_read(bank, offset, ret);
 	return ret;
 }
-/* TODO: dunno about the ret val. */
+static bool mt7601u_rf_use_mcu(struct mt7601u_dev *dev)
+{
+	return dev->rf_mcu && test_bit(MT7601U_STATE_MCU_RUNNING, &dev->state);
+}
+
+/* TODO: dunno about the ret val.
+ * Note: returns 0 if the update was done by the MCU, new value is not
+ *	 known then.  None of the callers look at it.
+ */
 static int
 mt7601u_rf_rmw(struct mt7601u_dev *dev, u8 bank, u8 offset, u8 mask, u8 val)
 {
+	struct mt76_reg_rmw rmw = { bank << 16 | offset, mask, val };
 	int ret;
+
+	if (mt7601u_rf_use_mcu(dev) &&
+	    !mt7601u_mcu_rmw_regs(dev, MT_MCU_MEMMAP_RF, &rmw, 1))
+		return 0;
+
 	ret = mt7601u_rf_rr(dev, bank, offset);
 	if (ret < 0)
 		return ret;
@@ -167,15 +181,69 @@ mt7601u_rf_rmw(struct mt7601u_dev *dev, u8 bank, u8 offset, u8 mask, u8 val)
 	return val;
 }
 
-static int mt7601u_rf_set(struct mt7601u_dev *dev, u8 bank, u8 offset, u8 val)
+#define RF_REG_PAIR(bank, reg, value)				\
+	{ MT_MCU_MEMMAP_RF | (bank) << 16 | (reg), value }
+
+#define RF_REG_RMW(bank, reg, mask, value)			\
+	{ MT_MCU_MEMMAP_RF | (bank) << 16 | (reg), mask, value }
+
+#define RF_REG_BANK(reg)	(((reg) >> 16) & 0xff)
+#define RF_REG_ID(reg)		((reg) & 0xff)
+
+/* Write a sequence of RF_REG_PAIR()s.  Once firmware is up the whole sequence
+ * goes out in one MCU command, the CSR path (two control xfers per register,
+ * plus polling) is only used before that or with rf_mcu turned off.
+ * Note: MCU applies the writes in order, so sequences which toggle the same
+ *	 register (e.g. VCO calibration kick) are fine.
+ */
+static int mt7601u_rf_wr_seq(struct mt7601u_dev *dev,
+			     const struct mt76_reg_pair *regs, int n)
 {
-	return mt7601u_rf_rmw(dev, bank, offset, 0, val);
+	int i, ret;
+
+	if (mt7601u_rf_use_mcu(dev)) {
+		for (i = 0; i < n; i++)
+			trace_rf_write(RF_REG_BANK(regs[i].reg),
+				       RF_REG_ID(regs[i].reg), regs[i].value);
+		return mt7601u_write_reg_pairs(dev, 0, regs, n);
+	}
+
+	for (i = 0; i < n; i++) {
+		ret = mt7601u_rf_wr(dev, RF_REG_BANK(regs[i].reg),
+				    RF_REG_ID(regs[i].reg), regs[i].value);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
 }
 
-static int
-mt7601u_rf_clear(struct mt7601u_dev *dev, u8 bank, u8 offset, u8 mask)
+/* Same for masked updates, see mt7601u_rf_rmw() for semantics.  On the CSR
+ * path full-mask entries are plain writes, no need to read them first.
+ */
+static int mt7601u_rf_rmw_seq(struct mt7601u_dev *dev,
+			      const struct mt76_reg_rmw *regs, int n)
 {
-	return mt7601u_rf_rmw(dev, bank, offset, mask, 0);
+	u8 bank, id;
+	int i, ret;
+
+	if (mt7601u_rf_use_mcu(dev))
+		return mt7601u_mcu_rmw_regs(dev, 0, regs, n);
+
+	for (i = 0; i < n; i++) {
+		bank = RF_REG_BANK(regs[i].reg);
+		id = RF_REG_ID(regs[i].reg);
+
+		if (regs[i].mask == 0xff)
+			ret = mt7601u_rf_wr(dev, bank, id, regs[i].value);
+		else
+			ret = mt7601u_rf_rmw(dev, bank, id, regs[i].mask,
+					     regs[i].value);
+		if (ret < 0)
+			return ret;
+	}
+
+	return 0;
 }
 
 int mt7601u_phy_get_rssi(struct mt7601u_dev *dev,
@@ -208,12 +276,19 @@ int mt7601u_phy_get_rssi(struct mt7601u_dev *dev,
 	return val;
 }
 
+/* Note: setting BIT(7) of R4 kicks off the calibration, R4 was just written
+ *	 so we know its value and don't have to read it back.
+ */
+static const struct mt76_reg_pair mt7601u_vco_cal_regs[] = {
+	RF_REG_PAIR(0, 4, 0x0a),
+	RF_REG_PAIR(0, 5, 0x20),
+	RF_REG_PAIR(0, 4, 0x0a | BIT(7)),
+};
+
 static void mt7601u_vco_cal(struct mt7601u_dev *dev)
 {
-	/* TODO: these two can be combined in an andes write */
-	mt7601u_rf_wr(dev, 0, 4, 0x0a);
-	mt7601u_rf_wr(dev, 0, 5, 0x20);
-	mt7601u_rf_set(dev, 0, 4, BIT(7));
+	mt7601u_rf_wr_seq(dev, mt7601u_vco_cal_regs,
+			  ARRAY_SIZE(mt7601u_vco_cal_regs));
 	msleep(2);
 }
 
@@ -352,7 +427,7 @@ static int __mt7601u_phy_set_channel(struct mt7601u_dev *dev,
 	if (ret)
 		return ret;
 
-	mt7601u_rmw(dev, MT_TX_ALC_CFG_0, 0x3f3f,
+	mt7601u_rmw_mcu(dev, MT_TX_ALC_CFG_0, 0x3f3f,
 		    dev->ee->chan_pwr[chan_idx] & 0x3f);
 
 	ret = mt7601u_write_reg_pairs(dev, MT_MCU_MEMMAP_BBP,
@@ -376,7 +451,7 @@ static int __mt7601u_phy_set_channel(struct mt7601u_dev *dev,
 
 	/* TODO: perhaps move this mess out of here? */
 	if (chan->hw_value != 14 || bw != MT_BW_20) {
-		mt7601u_bbp_rmw(dev, 4, 0x20, 0);
+		mt7601u_bbp_rmw_mcu(dev, 4, 0x20, 0);
 		mt7601u_bbp_wr(dev, 178, 0xff);
 
 		t->cck[0].bw20 = dev->ee->real_cck_bw20[0];
@@ -405,16 +480,34 @@ static int __mt7601u_phy_set_channel(struct mt7601u_dev *dev,
 	return 0;
 }
 
+static void mt7601u_xfer_account(struct mt7601u_dev *dev,
+				 enum mt7601u_xfer_op op, u64 start,
+				 ktime_t start_time)
+{
+	struct mt7601u_xfer_stat *st = &dev->xfer_stats[op];
+
+	st->last = mt7601u_xfers(dev) - start;
+	st->total += st->last;
+	st->last_us = ktime_us_delta(ktime_get(), start_time);
+	st->total_us += st->last_us;
+	st->runs++;
+}
+
 int mt7601u_phy_set_channel(struct mt7601u_dev *dev,
 			    struct cfg80211_chan_def *chandef)
 {
+	ktime_t start;
+	u64 xfers;
 	int ret;
 
 	cancel_delayed_work_sync(&dev->cal_work);
 	cancel_delayed_work_sync(&dev->freq_cal.work);
 
 	mutex_lock(&dev->hw_atomic_mutex);
+	xfers = mt7601u_xfers(dev);
+	start = ktime_get();
 	ret = __mt7601u_phy_set_channel(dev, chandef);
+	mt7601u_xfer_account(dev, MT_XFER_CHAN_SWITCH, xfers, start);
 	mutex_unlock(&dev->hw_atomic_mutex);
 	if (ret)
 		return ret;
@@ -606,7 +699,8 @@ mt7601u_set_initial_tssi(struct mt7601u_dev *dev, s16 tssi_db, s16 tssi_hvga_db)
 		 int_to_s6(init_offset) & MT_TX_ALC_CFG_1_TEMP_COMP);
 }
 
-static void mt7601u_tssi_dc_gain_cal(struct mt7601u_dev *dev)
+/* Returns TSSI init in dB, HVGA one is tssi_init_hvga_offset_db above it */
+static s16 mt7601u_tssi_dc_gain_cal(struct mt7601u_dev *dev)
 {
 	u8 rf_vga, rf_mixer, bbp_r47;
 	int i, j;
@@ -684,6 +778,125 @@ static void mt7601u_tssi_dc_gain_cal(struct mt7601u_dev *dev)
 	mt7601u_bbp_wr(dev, 47, bbp_r47);
 
 	mt7601u_set_initial_tssi(dev, tssi_init_db, tssi_init_hvga_db);
+
+	return tssi_init_db;
+}
+
+/* TSSI DC gain calibration results, kept as long as the module is loaded
+ * so that re-probing the same device at similar temperature can skip it.
+ * Entries are keyed by MAC address and temperature band, an entry with
+ * zero MAC address is free.
+ */
+#define MT_CAL_CACHE_SIZE		8
+#define MT_CAL_CACHE_TEMP_BAND		450
+
+static struct mt7601u_cal_cache_entry {
+	u8 macaddr[ETH_ALEN];
+	int temp_band;
+	unsigned long stamp;
+
+	s8 tssi_init;
+	s8 tssi_init_hvga;
+	s16 tssi_init_db;
+	s16 tssi_init_hvga_offset_db;
+	u32 cal_us;
+} mt7601u_cal_cache[MT_CAL_CACHE_SIZE];
+static DEFINE_MUTEX(mt7601u_cal_cache_mutex);
+
+static int mt7601u_cal_cache_band(struct mt7601u_dev *dev)
+{
+	return DIV_ROUND_CLOSEST(dev->curr_temp, MT_CAL_CACHE_TEMP_BAND);
+}
+
+/* Note: must be called with mt7601u_cal_cache_mutex held */
+static struct mt7601u_cal_cache_entry *
+mt7601u_cal_cache_find(struct mt7601u_dev *dev, bool alloc)
+{
+	struct mt7601u_cal_cache_entry *e, *oldest = &mt7601u_cal_cache[0];
+	int band = mt7601u_cal_cache_band(dev);
+	int i;
+
+	for (i = 0; i < MT_CAL_CACHE_SIZE; i++) {
+		e = &mt7601u_cal_cache[i];
+
+		if (ether_addr_equal(e->macaddr, dev->macaddr) &&
+		    e->temp_band == band)
+			return e;
+
+		if (is_zero_ether_addr(e->macaddr) ||
+		    (!is_zero_ether_addr(oldest->macaddr) &&
+		     time_before(e->stamp, oldest->stamp)))
+			oldest = e;
+	}
+
+	if (!alloc)
+		return NULL;
+
+	memset(oldest, 0, sizeof(*oldest));
+	ether_addr_copy(oldest->macaddr, dev->macaddr);
+	oldest->temp_band = band;
+
+	return oldest;
+}
+
+void mt7601u_cal_cache_flush(struct mt7601u_dev *dev)
+{
+	int i;
+
+	mutex_lock(&mt7601u_cal_cache_mutex);
+	for (i = 0; i < MT_CAL_CACHE_SIZE; i++)
+		if (ether_addr_equal(mt7601u_cal_cache[i].macaddr,
+				     dev->macaddr))
+			memset(&mt7601u_cal_cache[i], 0,
+			       sizeof(mt7601u_cal_cache[i]));
+	mutex_unlock(&mt7601u_cal_cache_mutex);
+}
+
+static void mt7601u_tssi_dc_gain_cal_cached(struct mt7601u_dev *dev)
+{
+	struct mt7601u_cal_cache_stats *st = &dev->cal_cache_stats;
+	struct mt7601u_cal_cache_entry *e, res;
+	ktime_t start = ktime_get();
+	bool hit = false;
+
+	mutex_lock(&mt7601u_cal_cache_mutex);
+	e = mt7601u_cal_cache_find(dev, false);
+	if (e) {
+		e->stamp = jiffies;
+		res = *e;
+		hit = true;
+	}
+	mutex_unlock(&mt7601u_cal_cache_mutex);
+
+	if (hit) {
+		dev->tssi_init = res.tssi_init;
+		dev->tssi_init_hvga = res.tssi_init_hvga;
+		dev->tssi_init_hvga_offset_db = res.tssi_init_hvga_offset_db;
+		mt7601u_set_initial_tssi(dev, res.tssi_init_db,
+					 res.tssi_init_db +
+					 res.tssi_init_hvga_offset_db);
+
+		st->hits++;
+		st->saved_us += res.cal_us;
+		return;
+	}
+
+	/* Nothing for this temperature band, do the full calibration */
+	res.tssi_init_db = mt7601u_tssi_dc_gain_cal(dev);
+	res.cal_us = ktime_us_delta(ktime_get(), start);
+
+	st->misses++;
+	st->cal_us = res.cal_us;
+
+	mutex_lock(&mt7601u_cal_cache_mutex);
+	e = mt7601u_cal_cache_find(dev, true);
+	e->tssi_init = dev->tssi_init;
+	e->tssi_init_hvga = dev->tssi_init_hvga;
+	e->tssi_init_db = res.tssi_init_db;
+	e->tssi_init_hvga_offset_db = dev->tssi_init_hvga_offset_db;
+	e->cal_us = res.cal_us;
+	e->stamp = jiffies;
+	mutex_unlock(&mt7601u_cal_cache_mutex);
 }
 
 static int mt7601u_bbp_temp(struct mt7601u_dev *dev,
@@ -736,17 +949,25 @@ static int mt7601u_temp_comp(struct mt7601u_dev *dev, bool on)
 
 	/* PLL Lock Protect */
 	if (temp < -50 && !dev->pll_lock_protect) { /* < 20C */
+		static const struct mt76_reg_rmw pll_lock_on[] = {
+			RF_REG_RMW(4,  4, 0xff, 6),
+			RF_REG_RMW(4, 10, 0x30, 0),
+		};
+
 		dev->pll_lock_protect =  true;
 
-		mt7601u_rf_wr(dev, 4, 4, 6);
-		mt7601u_rf_clear(dev, 4, 10, 0x30);
+		mt7601u_rf_rmw_seq(dev, pll_lock_on, ARRAY_SIZE(pll_lock_on));
 
 		trace_printk("PLL lock protect on - too cold\n");
 	} else if (temp > 50 && dev->pll_lock_protect) { /* > 30C */
+		static const struct mt76_reg_rmw pll_lock_off[] = {
+			RF_REG_RMW(4,  4, 0xff, 0),
+			RF_REG_RMW(4, 10, 0x30, 0x10),
+		};
+
 		dev->pll_lock_protect = false;
 
-		mt7601u_rf_wr(dev, 4, 4, 0);
-		mt7601u_rf_rmw(dev, 4, 10, 0x30, 0x10);
+		mt7601u_rf_rmw_seq(dev, pll_lock_off, ARRAY_SIZE(pll_lock_off));
 
 		trace_printk("PLL lock protect off\n");
 	}
@@ -1010,18 +1231,41 @@ static void mt7601u_phy_calibrate(struct work_struct *work)
 {
 	struct mt7601u_dev *dev = container_of(work, struct mt7601u_dev,
 					    cal_work.work);
+	u64 buf_gets = dev->mcu.stats.buf_gets;
+	ktime_t start;
+	u64 xfers;
 
+	mt7601u_io_prio_begin(dev, MT_IO_PRIO_BULK);
 	mt7601u_agc_tune(dev);
 	mt7601u_tssi_cal(dev);
 	/* If TSSI calibration was run it already updated temperature. */
 	if (!dev->ee->tssi_enabled)
 		dev->b49_temp = mt7601u_read_temp(dev);
+	xfers = mt7601u_xfers(dev);
+	start = ktime_get();
 	mt7601u_temp_comp(dev, true); /* TODO: find right value for @on */
+	mt7601u_xfer_account(dev, MT_XFER_TEMP_COMP, xfers, start);
+	mt7601u_io_prio_end(dev, MT_IO_PRIO_BULK);
+
+	dev->mcu.stats.cal_buf_gets = dev->mcu.stats.buf_gets - buf_gets;
 
 	ieee80211_queue_delayed_work(dev->hw, &dev->cal_work,
 				     MT_CALIBRATE_INTERVAL);
 }
 
+/* Apply the new frequency offset and recalibrate VCO in one go. */
+static void mt7601u_phy_freq_adjust(struct mt7601u_dev *dev)
+{
+	struct mt76_reg_pair regs[1 + ARRAY_SIZE(mt7601u_vco_cal_regs)] = {
+		RF_REG_PAIR(0, 12, dev->freq_cal.freq),
+	};
+
+	memcpy(regs + 1, mt7601u_vco_cal_regs, sizeof(mt7601u_vco_cal_regs));
+
+	mt7601u_rf_wr_seq(dev, regs, ARRAY_SIZE(regs));
+	msleep(2);
+}
+
 static unsigned long
 __mt7601u_phy_freq_cal(struct mt7601u_dev *dev, s8 last_offset, u8 phy_mode)
 {
@@ -1073,8 +1317,7 @@ __mt7601u_phy_freq_cal(struct mt7601u_dev *dev, s8 last_offset, u8 phy_mode)
 	}
 
 	trace_freq_cal_adjust(dev->freq_cal.freq);
-	mt7601u_rf_wr(dev, 0, 12, dev->freq_cal.freq);
-	mt7601u_vco_cal(dev);
+	mt7601u_phy_freq_adjust(dev);
 
 	return dev->freq_cal.adjusting ? MT_FREQ_CAL_ADJ_INTERVAL :
 					 MT_FREQ_CAL_CHECK_INTERVAL;
@@ -1087,13 +1330,18 @@ static void mt7601u_phy_freq_cal(struct work_struct *work)
 	s8 last_offset;
 	u8 phy_mode;
 	unsigned long delay;
+	ktime_t start;
+	u64 xfers;
 
 	spin_lock_bh(&dev->last_beacon.lock);
 	last_offset = dev->last_beacon.freq_off;
 	phy_mode = dev->last_beacon.phy_mode;
 	spin_unlock_bh(&dev->last_beacon.lock);
 
+	xfers = mt7601u_xfers(dev);
+	start = ktime_get();
 	delay = __mt7601u_phy_freq_cal(dev, last_offset, phy_mode);
+	mt7601u_xfer_account(dev, MT_XFER_FREQ_CAL, xfers, start);
 	ieee80211_queue_delayed_work(dev->hw, &dev->freq_cal.work, delay);
 
 	spin_lock_bh(&dev->last_beacon.lock);
@@ -1173,7 +1421,7 @@ static int mt7601u_init_cal(struct mt7601u_dev *dev)
 
 	mt7601u_rxdc_cal(dev);
 
-	mt7601u_tssi_dc_gain_cal(dev);
+	mt7601u_tssi_dc_gain_cal_cached(dev);
 
 	mt7601u_wr(dev, MT_MAC_SYS_CTRL, mac_ctrl);
 
@@ -1219,7 +1467,7 @@ int mt7601u_bbp_set_bw(struct mt7601u_dev *dev, int bw)
  */
 void mt7601u_set_rx_path(struct mt7601u_dev *dev, u8 path)
 {
-	mt7601u_bbp_rmw(dev, 3, 0x18, path << 3);
+	mt7601u_bbp_rmw_mcu(dev, 3, 0x18, path << 3);
 }
 
 /**
@@ -1232,9 +1480,6 @@ void mt7601u_set_tx_dac(struct mt7601u_dev *dev, u8 dac)
 	mt7601u_bbp_rmc(dev, 1, 0x18, dac << 3);
 }
 
-#define RF_REG_PAIR(bank, reg, value)				\
-	{ MT_MCU_MEMMAP_RF | (bank) << 16 | (reg), value }
-
 int mt7601u_phy_init(struct mt7601u_dev *dev)
 {
 	int ret;
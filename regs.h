@@ -540,6 +540,7 @@
 
 #define MT_TX_STAT_FIFO_EXT		0x1798
 #define MT_TX_STAT_FIFO_EXT_RETRY	GENMASK(7, 0)
+#define MT_TX_STAT_FIFO_EXT_PKTID	GENMASK(15, 8)
 
 #define MT_BBP_CORE_BASE		0x2000
 #define MT_BBP_IBI_BASE			0x2100
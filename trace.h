@@ -80,8 +80,8 @@ TRACE_EVENT(submit_urb,
 
 TRACE_EVENT(mt_mcu_msg_send,
 	TP_PROTO(struct mt7601u_dev *dev,
-		 struct sk_buff *skb, u32 csum, bool resp),
-	TP_ARGS(dev, skb, csum, resp),
+		 const void *data, u32 csum, bool resp),
+	TP_ARGS(dev, data, csum, resp),
 	TP_STRUCT__entry(
 		DEV_ENTRY
 		__field(u32, info)
@@ -90,7 +90,7 @@ TRACE_EVENT(mt_mcu_msg_send,
 	),
 	TP_fast_assign(
 		DEV_ASSIGN;
-		__entry->info = *(u32 *)skb->data;
+		__entry->info = get_unaligned_le32(data);
 		__entry->csum = csum;
 		__entry->resp = resp;
 	),
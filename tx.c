@@ -41,6 +41,54 @@ static u8 mt7601u_tx_pktid_enc(struct mt7601u_dev *dev, u8 rate, bool is_probe)
 	return encoded;
 }
 
+/* Take the next PKT_ID which has no status outstanding.  With more than
+ * MT_TX_PKTID_MAX frames waiting for status ids have to be shared, status
+ * decoding notices that and doesn't trust the entry then.
+ */
+static u8
+mt7601u_tx_pktid_alloc(struct mt7601u_dev *dev, u8 rate, bool is_probe)
+{
+	unsigned long flags;
+	u8 pktid, last;
+	int i;
+
+	spin_lock_irqsave(&dev->lock, flags);
+	last = dev->tx_pktid_last;
+	pktid = last;
+	for (i = 0; i < MT_TX_PKTID_MAX; i++) {
+		pktid = pktid % MT_TX_PKTID_MAX + 1;
+		if (!dev->tx_pktid[pktid].users)
+			break;
+	}
+	if (dev->tx_pktid[pktid].users)
+		pktid = last % MT_TX_PKTID_MAX + 1;
+
+	dev->tx_pktid_last = pktid;
+	dev->tx_pktid[pktid].rate = rate;
+	dev->tx_pktid[pktid].is_probe = is_probe;
+	dev->tx_pktid[pktid].prev = last;
+	dev->tx_pktid[pktid].ht_fbk = dev->ht_fbk;
+	if (dev->tx_pktid[pktid].users < U8_MAX)
+		dev->tx_pktid[pktid].users++;
+	spin_unlock_irqrestore(&dev->lock, flags);
+
+	return pktid;
+}
+
+/* Statuses which never come (FIFO overflow, failed URBs) would keep their
+ * ids busy forever, start over whenever status polling stops.
+ */
+static void mt7601u_tx_pktid_reset(struct mt7601u_dev *dev)
+{
+	unsigned long flags;
+	int i;
+
+	spin_lock_irqsave(&dev->lock, flags);
+	for (i = 0; i < ARRAY_SIZE(dev->tx_pktid); i++)
+		dev->tx_pktid[i].users = 0;
+	spin_unlock_irqrestore(&dev->lock, flags);
+}
+
 static void mt7601u_tx_skb_remove_dma_overhead(struct sk_buff *skb,
 					       struct ieee80211_tx_info *info)
 {
@@ -214,9 +262,14 @@ void mt7601u_tx(struct ieee80211_hw *hw, struct ieee80211_tx_control *control,
 	 *	 the number of reports which can be fetched.
 	 *	 Also the vendor driver never uses the EXT_FIFO register
 	 *	 so it may be untested.
+	 *	 When tx_stat_ext is enabled EXT_FIFO is read together with
+	 *	 every status and PKT_ID becomes a rolling per-frame id.
 	 */
 	is_probe = !!(info->flags & IEEE80211_TX_CTL_RATE_CTRL_PROBE);
-	pkt_id = mt7601u_tx_pktid_enc(dev, rate_ctl & 0x7, is_probe);
+	if (dev->tx_stat_ext)
+		pkt_id = mt7601u_tx_pktid_alloc(dev, rate_ctl & 0x7, is_probe);
+	else
+		pkt_id = mt7601u_tx_pktid_enc(dev, rate_ctl & 0x7, is_probe);
 	pkt_len |= MT76_SET(MT_TXWI_LEN_PKTID, pkt_id);
 	txwi->len_ctl = cpu_to_le16(pkt_len);
 
@@ -238,6 +291,7 @@ static void mt7601u_tx_pktid_dec(struct mt7601u_dev *dev,
 {
 	u8 req_rate = stat->pktid;
 	u8 eff_rate = stat->rate & 0x7;
+	u8 chain[MT_TX_FBK_CHAIN_MAX];
 
 	req_rate -= 1;
 
@@ -250,57 +304,268 @@ static void mt7601u_tx_pktid_dec(struct mt7601u_dev *dev,
 			req_rate = 7;
 	}
 
-	stat->retry = req_rate - eff_rate;
+	/* Note: table the frame was sent with isn't known in this mode, use
+	 *	 the current one.  It only changes on rate control updates
+	 *	 so few statuses are affected.
+	 */
+	stat->req_rate = req_rate;
+	stat->ht_fbk = READ_ONCE(dev->ht_fbk);
+	stat->retry = mt7601u_mac_tx_fbk_chain(stat, chain);
 }
 
-void mt7601u_tx_stat(struct work_struct *work)
+static void mt7601u_tx_pktid_dec_ext(struct mt7601u_dev *dev,
+				     struct mt76_tx_status *stat)
 {
-	struct mt7601u_dev *dev = container_of(work, struct mt7601u_dev,
-					       stat_work.work);
+	struct mt7601u_txs_stats *st = &dev->txs_stats;
+	u8 chain[MT_TX_FBK_CHAIN_MAX];
+	unsigned long flags;
+	int guess;
 
-	struct mt76_tx_status stat;
+	spin_lock_irqsave(&dev->lock, flags);
+	stat->stale = dev->tx_pktid[stat->pktid].users != 1;
+	stat->req_rate = dev->tx_pktid[stat->pktid].rate;
+	stat->is_probe = dev->tx_pktid[stat->pktid].is_probe;
+	stat->prev_pktid = dev->tx_pktid[stat->pktid].prev;
+	stat->ht_fbk = dev->tx_pktid[stat->pktid].ht_fbk;
+	if (dev->tx_pktid[stat->pktid].users)
+		dev->tx_pktid[stat->pktid].users--;
+	spin_unlock_irqrestore(&dev->lock, flags);
+
+	/* Entry may belong to another frame, EXT_FIFO retries are still
+	 * right but requested rate isn't known.
+	 */
+	if (stat->stale) {
+		st->pktid_stale++;
+		stat->req_rate = stat->rate & 0x7;
+		stat->is_probe = false;
+		return;
+	}
+
+	/* Keep track of what the PKT_ID-based guess would have been */
+	guess = mt7601u_mac_tx_fbk_chain(stat, chain);
+
+	st->ext_statuses++;
+	st->ext_retries += stat->retry;
+	st->pktid_retries += guess;
+	if (stat->retry == guess)
+		st->retry_match++;
+	else if (stat->retry > guess)
+		st->retry_ext_more++;
+	else
+		st->retry_ext_less++;
+}
+
+static void
+mt7601u_tx_stat_report(struct mt7601u_dev *dev, struct mt76_tx_status *stat,
+		       u8 n_frames, u8 n_acked)
+{
 	struct ieee80211_tx_info info = {};
 	struct ieee80211_sta *sta = NULL;
 	struct mt76_wcid *wcid = NULL;
 	void *msta;
-	int cleaned = 0;
-	unsigned long flags;
 
-	while (!test_bit(MT7601U_STATE_REMOVED, &dev->state)) {
-		stat = mt7601u_mac_fetch_tx_status(dev);
-		if (!stat.valid)
-			break;
+	rcu_read_lock();
+	if (stat->wcid < ARRAY_SIZE(dev->wcid))
+		wcid = rcu_dereference(dev->wcid[stat->wcid]);
 
-		mt7601u_tx_pktid_dec(dev, &stat);
+	if (wcid) {
+		msta = container_of(wcid, struct mt76_sta, wcid);
+		sta = container_of(msta, struct ieee80211_sta, drv_priv);
 
-		rcu_read_lock();
-		if (stat.wcid < ARRAY_SIZE(dev->wcid))
-			wcid = rcu_dereference(dev->wcid[stat.wcid]);
+		/* Note: only stat_work updates the average, no locking */
+		if (stat->aggr && wcid->ampdu_len_avg)
+			wcid->ampdu_len_avg = (wcid->ampdu_len_avg * 7 +
+					       n_frames * 16) / 8;
+		else if (stat->aggr)
+			wcid->ampdu_len_avg = n_frames * 16;
+	}
+
+	mt76_mac_fill_tx_status(dev, &info, stat);
+	info.status.ampdu_len = n_frames;
+	info.status.ampdu_ack_len = n_acked;
 
-		if (wcid) {
-			msta = container_of(wcid, struct mt76_sta, wcid);
-			sta = container_of(msta, struct ieee80211_sta,
-					   drv_priv);
+	ieee80211_tx_status_noskb(dev->hw, sta, &info);
+	rcu_read_unlock();
+}
+
+/* Consecutive statuses of frames from the same A-MPDU are reported to
+ * mac80211 as one, with A-MPDU length and number of acked subframes filled
+ * in.  Subframes of one A-MPDU have the aggr bit set, go to one station and
+ * share the final rate.  Their PKT_IDs are equal (rate encoding) or
+ * allocated one after another (EXT_FIFO mode), anything else starts a new
+ * run.
+ * Note: retries are reported once per A-MPDU and often a frame early (see
+ *	 mt7601u_tx()) so they can't be used to find the boundaries, the run
+ *	 takes the highest retry count of its frames.
+ * Note: back-to-back A-MPDUs to one station at one rate can't be told
+ *	 apart, MT_TX_STAT_MAX_AMPDU limits the damage.
+ */
+struct mt7601u_tx_stat_run {
+	struct mt76_tx_status stat;
+	u8 last_pktid;
+	u8 n_frames;
+	u8 n_acked;
+};
+
+static bool
+mt7601u_tx_stat_same_ampdu(struct mt7601u_tx_stat_run *run,
+			   struct mt76_tx_status *stat)
+{
+	struct mt76_tx_status *last = &run->stat;
+	u8 pktid = run->last_pktid;
+
+	if (!run->n_frames || run->n_frames >= MT_TX_STAT_MAX_AMPDU ||
+	    !last->aggr || !stat->aggr || last->wcid != stat->wcid ||
+	    last->rate != stat->rate || last->has_ext != stat->has_ext)
+		return false;
+
+	if (stat->has_ext)
+		return !last->stale && !stat->stale &&
+		       stat->prev_pktid == pktid &&
+		       last->req_rate == stat->req_rate &&
+		       last->is_probe == stat->is_probe &&
+		       last->ht_fbk == stat->ht_fbk;
+
+	return stat->pktid == pktid;
+}
+
+static void
+mt7601u_tx_stat_flush(struct mt7601u_dev *dev, struct mt7601u_tx_stat_run *run)
+{
+	if (!run->n_frames)
+		return;
+
+	mt7601u_tx_stat_report(dev, &run->stat, run->n_frames, run->n_acked);
+	run->n_frames = 0;
+}
+
+static void
+mt7601u_tx_stat_add(struct mt7601u_dev *dev, struct mt7601u_tx_stat_run *run,
+		    struct mt76_tx_status *stat)
+{
+	struct mt76_tx_status *last = &run->stat;
+
+	if (stat->has_ext)
+		mt7601u_tx_pktid_dec_ext(dev, stat);
+	else
+		mt7601u_tx_pktid_dec(dev, stat);
+
+	if (mt7601u_tx_stat_same_ampdu(run, stat)) {
+		last->success |= stat->success;
+		last->retry = max(last->retry, stat->retry);
+		run->last_pktid = stat->pktid;
+		run->n_frames++;
+		run->n_acked += stat->success;
+		return;
+	}
+
+	mt7601u_tx_stat_flush(dev, run);
+
+	run->stat = *stat;
+	run->last_pktid = stat->pktid;
+	run->n_frames = 1;
+	run->n_acked = stat->success;
+}
+
+/* Pick the delay until next poll so that FIFO gets roughly half full, based
+ * on the rate at which statuses were generated since the last poll.  When
+ * nothing was found keep backing off as long as there are frames which should
+ * still produce a status.  Returns 0 if polling should stop.
+ */
+static u32 mt7601u_tx_stat_next_delay(struct mt7601u_dev *dev, int cleaned,
+				      s64 elapsed_us)
+{
+	u64 delay;
+
+	dev->tx_stat_pending -= min_t(u32, dev->tx_stat_pending, cleaned);
+
+	if (cleaned) {
+		dev->tx_stat_idle = 0;
+
+		delay = div_u64(max_t(s64, elapsed_us, 0) *
+				(MT_TX_STAT_FIFO_DEPTH / 2), cleaned);
+	} else {
+		if (!dev->tx_stat_pending ||
+		    ++dev->tx_stat_idle > MT_TX_STAT_MAX_IDLE) {
+			dev->txs_stats.lost += dev->tx_stat_pending;
+			dev->tx_stat_pending = 0;
+			return 0;
 		}
 
-		mt76_mac_fill_tx_status(dev, &info, &stat);
-		ieee80211_tx_status_noskb(dev->hw, sta, &info);
-		rcu_read_unlock();
+		delay = dev->tx_stat_delay * 2;
+	}
+
+	return clamp_t(u64, delay, MT_TX_STAT_MIN_DELAY_US,
+		       MT_TX_STAT_MAX_DELAY_US);
+}
+
+void mt7601u_tx_stat(struct work_struct *work)
+{
+	struct mt7601u_dev *dev = container_of(work, struct mt7601u_dev,
+					       stat_work.work);
+	struct mt76_tx_status stat[MT_TX_STAT_BATCH];
+	struct mt7601u_tx_stat_run run = {};
+	int cleaned = 0, full = 0, valid, n, i;
+	unsigned long flags;
+	ktime_t start;
+	s64 elapsed;
+	u32 delay;
+
+	start = ktime_get();
 
-		cleaned++;
+	mt7601u_io_prio_begin(dev, MT_IO_PRIO_DATAPATH);
+	while (!test_bit(MT7601U_STATE_REMOVED, &dev->state)) {
+		n = mt7601u_mac_fetch_tx_status_batch(dev, stat,
+						      ARRAY_SIZE(stat));
+
+		valid = 0;
+		for (i = 0; i < n; i++)
+			if (stat[i].valid) {
+				mt7601u_tx_stat_add(dev, &run, &stat[i]);
+				valid++;
+			}
+		cleaned += valid;
+
+		/* One batch is read quicker than the FIFO refills, finding
+		 * as many entries as it holds means it was full already.
+		 */
+		if (valid >= MT_TX_STAT_FIFO_DEPTH)
+			full++;
+
+		/* FIFO was already empty when the last entry was popped */
+		if (!stat[n - 1].valid)
+			break;
 	}
+	mt7601u_tx_stat_flush(dev, &run);
+	mt7601u_io_prio_end(dev, MT_IO_PRIO_DATAPATH);
 	trace_mt_tx_status_cleaned(dev, cleaned);
 
 	spin_lock_irqsave(&dev->tx_lock, flags);
-	if (cleaned)
-		queue_delayed_work(dev->stat_wq, &dev->stat_work,
-				   msecs_to_jiffies(10));
-	else if (__test_and_clear_bit(MT7601U_STATE_MORE_STATS, &dev->state))
+
+	dev->txs_stats.polls++;
+	dev->txs_stats.statuses += cleaned;
+	dev->txs_stats.drain_us += ktime_us_delta(ktime_get(), start);
+	dev->txs_stats.fifo_full += full;
+	if (!cleaned)
+		dev->txs_stats.empty_polls++;
+
+	elapsed = ktime_us_delta(start, dev->tx_stat_last);
+	dev->tx_stat_last = start;
+	dev->tx_stat_kicked = false;
+
+	delay = mt7601u_tx_stat_next_delay(dev, cleaned, elapsed);
+	if (delay) {
+		dev->tx_stat_delay = delay;
 		queue_delayed_work(dev->stat_wq, &dev->stat_work,
-				   msecs_to_jiffies(20));
-	else
+				   usecs_to_jiffies(delay));
+	} else {
 		__clear_bit(MT7601U_STATE_READING_STATS, &dev->state);
+	}
+
 	spin_unlock_irqrestore(&dev->tx_lock, flags);
+
+	if (!delay)
+		mt7601u_tx_pktid_reset(dev);
 }
 
 int mt7601u_conf_tx(struct ieee80211_hw *hw, struct ieee80211_vif *vif,
@@ -339,27 +604,27 @@ int mt7601u_conf_tx(struct ieee80211_hw *hw, struct ieee80211_vif *vif,
 		val |= 0x60;
 	else
 		val |= MT76_SET(MT_EDCA_CFG_TXOP, params->txop);
-	mt76_wr(dev, MT_EDCA_CFG_AC(hw_q), val);
+	mt7601u_wr_posted(dev, MT_EDCA_CFG_AC(hw_q), val);
 
 	val = mt76_rr(dev, MT_WMM_TXOP(hw_q));
 	val &= ~(MT_WMM_TXOP_MASK << MT_WMM_TXOP_SHIFT(hw_q));
 	val |= params->txop << MT_WMM_TXOP_SHIFT(hw_q);
-	mt76_wr(dev, MT_WMM_TXOP(hw_q), val);
+	mt7601u_wr_posted(dev, MT_WMM_TXOP(hw_q), val);
 
 	val = mt76_rr(dev, MT_WMM_AIFSN);
 	val &= ~(MT_WMM_AIFSN_MASK << MT_WMM_AIFSN_SHIFT(hw_q));
 	val |= params->aifs << MT_WMM_AIFSN_SHIFT(hw_q);
-	mt76_wr(dev, MT_WMM_AIFSN, val);
+	mt7601u_wr_posted(dev, MT_WMM_AIFSN, val);
 
 	val = mt76_rr(dev, MT_WMM_CWMIN);
 	val &= ~(MT_WMM_CWMIN_MASK << MT_WMM_CWMIN_SHIFT(hw_q));
 	val |= cw_min << MT_WMM_CWMIN_SHIFT(hw_q);
-	mt76_wr(dev, MT_WMM_CWMIN, val);
+	mt7601u_wr_posted(dev, MT_WMM_CWMIN, val);
 
 	val = mt76_rr(dev, MT_WMM_CWMAX);
 	val &= ~(MT_WMM_CWMAX_MASK << MT_WMM_CWMAX_SHIFT(hw_q));
 	val |= cw_max << MT_WMM_CWMAX_SHIFT(hw_q);
-	mt76_wr(dev, MT_WMM_CWMAX, val);
+	mt7601u_wr_posted(dev, MT_WMM_CWMAX, val);
 
 	return 0;
 }
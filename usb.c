@@ -17,6 +17,7 @@
 
 #include "mt7601u.h"
 #include "usb.h"
+#include "mcu.h"
 #include "trace.h"
 
 static struct usb_device_id mt7601u_device_table[] = {
@@ -71,51 +72,440 @@ int mt7601u_usb_submit_buf(struct mt7601u_dev *dev, int dir, int ep_idx,
 	return ret;
 }
 
+static enum mt7601u_vend_type mt7601u_vend_type(const u8 req)
+{
+	switch (req) {
+	case VEND_MULTI_READ:
+		return MT_VEND_TYPE_READ;
+	case VEND_WRITE_FCE:
+		return MT_VEND_TYPE_FCE;
+	case VEND_DEV_MODE:
+		return MT_VEND_TYPE_DEV_MODE;
+	case VEND_WRITE:
+	case VEND_MULTI_WRITE:
+		return MT_VEND_TYPE_WRITE;
+	default:
+		return MT_VEND_TYPE_OTHER;
+	}
+}
+
+/* Retry policy per request type.  First try uses a short timeout which is
+ * doubled after every timed out try, up to MT7601U_VENDOR_REQ_TOUT_MS.
+ */
+static const struct mt7601u_vend_policy {
+	u8 max_tries;
+	u16 first_tout_ms;
+} mt7601u_vend_policy[__MT_VEND_TYPE_MAX] = {
+	[MT_VEND_TYPE_READ]	= { 3,	50 },
+	[MT_VEND_TYPE_WRITE]	= { 5,	50 },
+	[MT_VEND_TYPE_FCE]	= { MT7601U_VENDOR_REQ_MAX_RETRY, 100 },
+	[MT_VEND_TYPE_DEV_MODE]	= { 3,	MT7601U_VENDOR_REQ_TOUT_MS },
+	/* Unknown requests get the old, conservative behaviour */
+	[MT_VEND_TYPE_OTHER]	= { MT7601U_VENDOR_REQ_MAX_RETRY,
+				    MT7601U_VENDOR_REQ_TOUT_MS },
+};
+
+static void mt7601u_vendor_breaker_fail(struct mt7601u_dev *dev)
+{
+	dev->vend_breaker_since = jiffies;
+
+	/* Trial request failed, stay open and don't queue another reset */
+	if (dev->vend_breaker_open)
+		return;
+
+	if (!dev->vend_breaker_thresh ||
+	    !test_bit(MT7601U_STATE_INITIALIZED, &dev->state) ||
+	    ++dev->vend_fail_streak < dev->vend_breaker_thresh)
+		return;
+
+	dev->vend_breaker_open = true;
+	dev->usb_stats.breaker_trips++;
+
+	dev_err(dev->dev, "Error: %d vendor requests in a row failed, "
+		"resetting device\n", dev->vend_fail_streak);
+	usb_queue_reset_device(to_usb_interface(dev->dev));
+}
+
+static void mt7601u_vendor_breaker_ok(struct mt7601u_dev *dev)
+{
+	dev->vend_fail_streak = 0;
+
+	if (!dev->vend_breaker_open)
+		return;
+
+	dev->vend_breaker_open = false;
+	dev_info(dev->dev, "Vendor requests work again\n");
+}
+
+/* Open breaker fails requests until the cooldown passes, then lets one
+ * through as a trial.
+ */
+static bool mt7601u_vendor_breaker_rejects(struct mt7601u_dev *dev)
+{
+	if (!dev->vend_breaker_open ||
+	    time_after_eq(jiffies, dev->vend_breaker_since +
+				   MT7601U_VENDOR_BREAKER_COOLDOWN))
+		return false;
+
+	dev->usb_stats.rejected++;
+	return true;
+}
+
+static inline int mt7601u_usb_hist_bucket(u32 us)
+{
+	return min_t(int, fls(us), MT_USB_HIST_BUCKETS - 1);
+}
+
+/* Note: must be called with vendor_req_mutex held */
 static int
-__mt7601u_vendor_request(struct usb_device *usb_dev, unsigned int pipe,
-			 const u8 req, const u8 direction, const u16 val,
-			 const u16 offset, void *buf, const size_t buflen)
+__mt7601u_vendor_request(struct mt7601u_dev *dev, struct usb_device *usb_dev,
+			 unsigned int pipe, const u8 req, const u8 direction,
+			 const u16 val, const u16 offset,
+			 void *buf, const size_t buflen)
 {
-	int i, ret;
+	struct mt7601u_usb_stats *st = &dev->usb_stats;
 	const u8 req_type = direction | USB_TYPE_VENDOR | USB_RECIP_DEVICE;
+	enum mt7601u_vend_type type = mt7601u_vend_type(req);
+	const struct mt7601u_vend_policy *pol = &mt7601u_vend_policy[type];
+	unsigned int tout = pol->first_tout_ms;
+	ktime_t start = ktime_get();
+	int i, ret;
+
+	if (mt7601u_vendor_breaker_rejects(dev))
+		return -EIO;
 
-	for (i = 0; i < MT7601U_VENDOR_REQ_MAX_RETRY; i++) {
+	for (i = 0; i < pol->max_tries; i++) {
 		ret = usb_control_msg(usb_dev, pipe, req, req_type,
-				      val, offset, buf, buflen,
-				      MT7601U_VENDOR_REQ_TOUT_MS);
+				      val, offset, buf, buflen, tout);
 		trace_vend_req(pipe, req, req_type, val, offset,
 			       buf, buflen, ret);
 
 		if (ret >= 0 || ret == -ENODEV)
-			return ret;
+			break;
+
+		if (ret == -ETIMEDOUT) {
+			st->timeouts++;
+			tout = min_t(unsigned int, tout * 2,
+				     MT7601U_VENDOR_REQ_TOUT_MS);
+		}
 
 		msleep(5);
 	}
 
+	st->reqs[type]++;
+	st->lat[type][mt7601u_usb_hist_bucket(ktime_us_delta(ktime_get(),
+							     start))]++;
+	st->retries[min(i, MT7601U_VENDOR_REQ_MAX_RETRY)]++;
+
+	if (ret >= 0 || ret == -ENODEV) {
+		mt7601u_vendor_breaker_ok(dev);
+		return ret;
+	}
+
+	st->failures++;
 	printk("Vendor request failed: %d [req:0x%02x offset:0x%04x]\n",
 	       ret, req, offset);
 
+	mt7601u_vendor_breaker_fail(dev);
+
 	return ret;
 }
 
-int
-mt7601u_vendor_request(struct mt7601u_dev *dev, const u8 req,
-		       const u8 direction, const u16 val, const u16 offset,
-		       void *buf, const size_t buflen)
+static enum mt7601u_io_prio mt7601u_io_prio(struct mt7601u_dev *dev)
+{
+	if (READ_ONCE(dev->io_owner[MT_IO_PRIO_DATAPATH]) == current)
+		return MT_IO_PRIO_DATAPATH;
+	if (READ_ONCE(dev->io_owner[MT_IO_PRIO_BULK]) == current)
+		return MT_IO_PRIO_BULK;
+	return MT_IO_PRIO_NORMAL;
+}
+
+static bool
+mt7601u_io_higher_waiting(struct mt7601u_dev *dev, enum mt7601u_io_prio prio)
+{
+	int i;
+
+	for (i = 0; i < prio; i++)
+		if (atomic_read(&dev->io_waiting[i]))
+			return true;
+	return false;
+}
+
+/* Requests of lower priority classes are held back as long as there are
+ * higher priority ones waiting, so e.g. TX status reads can get in between
+ * transactions of a long calibration sequence.
+ */
+static void mt7601u_vendor_lock(struct mt7601u_dev *dev)
+{
+	enum mt7601u_io_prio prio = mt7601u_io_prio(dev);
+	struct mt7601u_usb_stats *st = &dev->usb_stats;
+	ktime_t start = ktime_get();
+	u32 wait;
+
+	atomic_inc(&dev->io_waiting[prio]);
+	wait_event(dev->io_wq, !mt7601u_io_higher_waiting(dev, prio));
+
+	mutex_lock(&dev->vendor_req_mutex);
+
+	if (atomic_dec_and_test(&dev->io_waiting[prio]) &&
+	    prio != MT_IO_PRIO_BULK)
+		wake_up_all(&dev->io_wq);
+
+	wait = ktime_us_delta(ktime_get(), start);
+	st->lock_wait_us += wait;
+	st->lock_wait[mt7601u_usb_hist_bucket(wait)]++;
+	st->prio_reqs[prio]++;
+	st->prio_wait_us[prio] += wait;
+	st->prio_max_us[prio] = max(st->prio_max_us[prio], wait);
+}
+
+static void mt7601u_vendor_unlock(struct mt7601u_dev *dev)
+{
+	mutex_unlock(&dev->vendor_req_mutex);
+}
+
+/* Note: must be called with vendor_req_mutex held */
+static int
+__mt7601u_vendor_req(struct mt7601u_dev *dev, const u8 req,
+		     const u8 direction, const u16 val, const u16 offset,
+		     void *buf, const size_t buflen)
 {
 	struct usb_device *usb_dev = mt7601u_to_usb_dev(dev);
 	unsigned int pipe = (direction == USB_DIR_IN) ?
 		usb_rcvctrlpipe(usb_dev, 0) : usb_sndctrlpipe(usb_dev, 0);
 	int ret;
 
-	mutex_lock(&dev->vendor_req_mutex);
+	/* Data stage can't be on the stack, bounce it via vend_buf */
+	if (buflen && direction == USB_DIR_OUT)
+		memcpy(dev->vend_buf, buf, buflen);
 
-	ret = __mt7601u_vendor_request(usb_dev, pipe, req, direction,
-				       val, offset, buf, buflen);
+	dev->vend_reqs++;
+	ret = __mt7601u_vendor_request(dev, usb_dev, pipe, req, direction,
+				       val, offset,
+				       buflen ? dev->vend_buf : NULL, buflen);
 	if (ret == -ENODEV)
 		set_bit(MT7601U_STATE_REMOVED, &dev->state);
 
-	mutex_unlock(&dev->vendor_req_mutex);
+	if (ret > 0 && direction == USB_DIR_IN)
+		memcpy(buf, dev->vend_buf, min_t(size_t, ret, buflen));
+
+	return ret;
+}
+
+/* Posted register write, i.e. an async control URB which nobody waits for
+ * until the next flush.  Kept on dev->posted_wrs in submission order.
+ */
+struct mt7601u_posted_wr {
+	struct list_head list;
+	struct mt7601u_dev *dev;
+	struct urb *urb;
+	ktime_t start;
+	u32 lat_us;
+	int status;
+
+	u8 req;
+	u16 val;
+	u16 offset;
+	u16 len;
+
+	struct usb_ctrlrequest setup;
+	__le32 data;
+};
+
+static void mt7601u_vendor_post_complete(struct urb *urb)
+{
+	struct mt7601u_posted_wr *pw = urb->context;
+	struct mt7601u_posted_stats *st = &pw->dev->posted_stats;
+	u32 lat = ktime_us_delta(ktime_get(), pw->start);
+	unsigned long flags;
+
+	pw->status = urb->status;
+	pw->lat_us = lat;
+
+	spin_lock_irqsave(&pw->dev->posted_lock, flags);
+	st->lat_total_us += lat;
+	st->lat_max_us = max(st->lat_max_us, lat);
+	if (urb->status)
+		st->errors++;
+	spin_unlock_irqrestore(&pw->dev->posted_lock, flags);
+}
+
+static int
+mt7601u_vendor_post(struct mt7601u_dev *dev, const u8 req, const u16 val,
+		    const u16 offset, const void *buf, const u16 buflen)
+{
+	struct usb_device *usb_dev = mt7601u_to_usb_dev(dev);
+	struct mt7601u_posted_wr *pw;
+	unsigned long flags;
+	int ret;
+
+	if (WARN_ON(buflen > sizeof(pw->data)))
+		return -EINVAL;
+
+	if (mt7601u_vendor_breaker_rejects(dev))
+		return -EIO;
+
+	pw = kzalloc(sizeof(*pw), GFP_KERNEL);
+	if (!pw)
+		return -ENOMEM;
+	pw->urb = usb_alloc_urb(0, GFP_KERNEL);
+	if (!pw->urb) {
+		kfree(pw);
+		return -ENOMEM;
+	}
+
+	pw->dev = dev;
+	pw->req = req;
+	pw->val = val;
+	pw->offset = offset;
+	pw->len = buflen;
+	memcpy(&pw->data, buf, buflen);
+
+	pw->setup.bRequestType = USB_DIR_OUT | USB_TYPE_VENDOR |
+				 USB_RECIP_DEVICE;
+	pw->setup.bRequest = req;
+	pw->setup.wValue = cpu_to_le16(val);
+	pw->setup.wIndex = cpu_to_le16(offset);
+	pw->setup.wLength = cpu_to_le16(buflen);
+
+	usb_fill_control_urb(pw->urb, usb_dev, usb_sndctrlpipe(usb_dev, 0),
+			     (void *)&pw->setup, buflen ? &pw->data : NULL,
+			     buflen, mt7601u_vendor_post_complete, pw);
+	usb_anchor_urb(pw->urb, &dev->posted_anchor);
+
+	dev->vend_reqs++;
+	pw->start = ktime_get();
+	ret = usb_submit_urb(pw->urb, GFP_KERNEL);
+	if (ret) {
+		usb_unanchor_urb(pw->urb);
+		usb_free_urb(pw->urb);
+		kfree(pw);
+		return ret;
+	}
+
+	list_add_tail(&pw->list, &dev->posted_wrs);
+
+	spin_lock_irqsave(&dev->posted_lock, flags);
+	dev->posted_stats.posted++;
+	spin_unlock_irqrestore(&dev->posted_lock, flags);
+
+	return 0;
+}
+
+static void
+mt7601u_reg_cache_wr(struct mt7601u_dev *dev, u32 offset, u32 val, bool valid);
+
+/* Posted URBs count in usb_stats and the breaker like synchronous requests,
+ * without retries.
+ * Note: must be called with vendor_req_mutex held
+ */
+static void
+mt7601u_vendor_post_account(struct mt7601u_dev *dev,
+			    const struct mt7601u_posted_wr *pw)
+{
+	struct mt7601u_usb_stats *st = &dev->usb_stats;
+	enum mt7601u_vend_type type = mt7601u_vend_type(pw->req);
+
+	st->reqs[type]++;
+	st->lat[type][mt7601u_usb_hist_bucket(pw->lat_us)]++;
+	st->retries[0]++;
+
+	if (pw->status == -ENODEV)
+		set_bit(MT7601U_STATE_REMOVED, &dev->state);
+
+	if (!pw->status || pw->status == -ENODEV) {
+		mt7601u_vendor_breaker_ok(dev);
+		return;
+	}
+
+	st->failures++;
+	mt7601u_vendor_breaker_fail(dev);
+}
+
+/* Wait for all posted writes to complete.  If any of them failed replay it,
+ * together with everything posted after it, synchronously to preserve the
+ * order in which registers were written.
+ * Note: must be called with vendor_req_mutex held
+ */
+static void __mt7601u_vendor_flush(struct mt7601u_dev *dev)
+{
+	struct mt7601u_posted_wr *pw, *tmp;
+	bool replay = false;
+	unsigned long flags;
+	u32 replayed = 0;
+	int ret;
+
+	if (list_empty(&dev->posted_wrs))
+		return;
+
+	if (!usb_wait_anchor_empty_timeout(&dev->posted_anchor,
+					   MT7601U_VENDOR_REQ_TOUT_MS))
+		usb_kill_anchored_urbs(&dev->posted_anchor);
+
+	list_for_each_entry_safe(pw, tmp, &dev->posted_wrs, list) {
+		mt7601u_vendor_post_account(dev, pw);
+		if (pw->status)
+			replay = true;
+
+		if (replay && !test_bit(MT7601U_STATE_REMOVED, &dev->state)) {
+			ret = __mt7601u_vendor_req(dev, pw->req, USB_DIR_OUT,
+						   pw->val, pw->offset,
+						   pw->len ? &pw->data : NULL,
+						   pw->len);
+			replayed++;
+
+			/* Shadow was updated when the write was posted */
+			if (ret < 0)
+				mt7601u_reg_cache_wr(dev, pw->offset & ~3, 0,
+						     false);
+		}
+
+		list_del(&pw->list);
+		usb_free_urb(pw->urb);
+		kfree(pw);
+	}
+
+	spin_lock_irqsave(&dev->posted_lock, flags);
+	dev->posted_stats.flushes++;
+	dev->posted_stats.replayed += replayed;
+	spin_unlock_irqrestore(&dev->posted_lock, flags);
+}
+
+void mt7601u_vendor_flush(struct mt7601u_dev *dev)
+{
+	mt7601u_vendor_lock(dev);
+	__mt7601u_vendor_flush(dev);
+	mt7601u_vendor_unlock(dev);
+}
+
+int
+mt7601u_vendor_request(struct mt7601u_dev *dev, const u8 req,
+		       const u8 direction, const u16 val, const u16 offset,
+		       void *buf, const size_t buflen)
+{
+	int ret;
+
+	if (WARN_ON(buflen > MT_VEND_BUF))
+		return -EINVAL;
+
+	/* Writes recorded by current task must land before anything else */
+	if (mt7601u_wr_batch_owner(dev))
+		mt7601u_wr_batch_flush(dev);
+
+	/* Don't let register accesses overtake own queued MCU commands,
+	 * commands of other tasks don't hold up the priority gate below.
+	 */
+	mt7601u_mcu_wait_idle(dev);
+
+	mt7601u_vendor_lock(dev);
+
+	/* Synchronous requests act as barriers for posted writes */
+	__mt7601u_vendor_flush(dev);
+
+	ret = __mt7601u_vendor_req(dev, req, direction, val, offset,
+				   buf, buflen);
+
+	mt7601u_vendor_unlock(dev);
 
 	return ret;
 }
@@ -124,17 +514,190 @@ void mt7601u_vendor_reset(struct mt7601u_dev *dev)
 {
 	mt7601u_vendor_request(dev, VEND_DEV_MODE, USB_DIR_OUT,
 			       VEND_DEV_MODE_RESET, 0, NULL, 0);
+	mt7601u_reg_cache_invalidate(dev);
+	mt7601u_bbp_cache_invalidate(dev);
+}
+
+/* MAC registers which are modified only by the driver, reads of these are
+ * served from the shadow copy.  Everything else is treated as volatile.
+ * Note: registers which are only ever written (never read) by the driver
+ *	 end up here too, the shadow is then used to skip redundant writes.
+ */
+static const struct {
+	u16 start;
+	u16 end;
+} mt7601u_reg_cache_map[] = {
+	{ MT_WMM_AIFSN,		MT_WMM_TXOP_BASE + 8 },
+	{ MT_MAC_ADDR_DW0,	MT_MAC_BSSID_DW1 + 4 },
+	{ MT_XIFS_TIME_CFG,	MT_BKOFF_SLOT_CFG + 4 },
+	{ MT_BEACON_TIME_CFG,	MT_BEACON_TIME_CFG + 4 },
+	{ MT_EDCA_CFG_BASE,	MT_EDCA_CFG_BASE + 16 },
+	{ MT_TX_BAND_CFG,	MT_TX_BAND_CFG + 4 },
+	{ MT_TXOP_CTRL_CFG,	MT_GF40_PROT_CFG + 4 },
+	{ MT_RX_FILTR_CFG,	MT_HT_BASIC_RATE + 4 },
+};
+
+static int mt7601u_reg_cache_idx(u32 offset)
+{
+	int i, idx = 0;
+
+	if (offset & 3)
+		return -1;
+
+	for (i = 0; i < ARRAY_SIZE(mt7601u_reg_cache_map); i++) {
+		u32 start = mt7601u_reg_cache_map[i].start;
+		u32 end = mt7601u_reg_cache_map[i].end;
+
+		if (offset >= start && offset < end) {
+			idx += (offset - start) / 4;
+			return WARN_ON(idx >= MT_REG_CACHE_SIZE) ? -1 : idx;
+		}
+
+		idx += (end - start) / 4;
+	}
+
+	return -1;
+}
+
+/* On a miss returns the write generation to pass to the fill */
+static bool
+mt7601u_reg_cache_get(struct mt7601u_dev *dev, int idx, u32 *val, u32 *gen)
+{
+	bool hit;
+
+	spin_lock_bh(&dev->reg_cache_lock);
+	dev->reg_cache_stats.reads++;
+	hit = dev->reg_cache_en && test_bit(idx, dev->reg_cache_valid);
+	if (hit) {
+		dev->reg_cache_stats.hits++;
+		*val = dev->reg_cache[idx];
+	}
+	*gen = dev->reg_cache_gen;
+	spin_unlock_bh(&dev->reg_cache_lock);
+
+	return hit;
+}
+
+static bool mt7601u_reg_cache_resets(u32 offset, u32 val)
+{
+	return offset == MT_MAC_SYS_CTRL && val & MT_MAC_SYS_CTRL_RESET_CSR;
+}
+
+static void __mt7601u_reg_cache_invalidate(struct mt7601u_dev *dev)
+{
+	bitmap_zero(dev->reg_cache_valid, MT_REG_CACHE_SIZE);
+	dev->reg_cache_gen++;
+	dev->reg_cache_stats.resyncs++;
+}
+
+/* All register writes, direct, posted, batched or done by the MCU, have to
+ * be reported here.  Bumps the generation so that reads which were in
+ * flight don't fill the shadow with what they saw before the write.
+ */
+static void
+mt7601u_reg_cache_wr(struct mt7601u_dev *dev, u32 offset, u32 val, bool valid)
+{
+	int idx = mt7601u_reg_cache_idx(offset);
+	bool reset = mt7601u_reg_cache_resets(offset, val);
+
+	if (idx < 0 && !reset)
+		return;
+
+	spin_lock_bh(&dev->reg_cache_lock);
+	if (idx >= 0) {
+		dev->reg_cache[idx] = val;
+		if (valid)
+			__set_bit(idx, dev->reg_cache_valid);
+		else
+			__clear_bit(idx, dev->reg_cache_valid);
+		dev->reg_cache_gen++;
+		dev->reg_cache_stats.writes++;
+	}
+	/* CSR reset puts MAC registers back to their defaults */
+	if (reset)
+		__mt7601u_reg_cache_invalidate(dev);
+	spin_unlock_bh(&dev->reg_cache_lock);
+}
+
+/* Write-through for writes which don't go through __mt7601u_wr() */
+void mt7601u_reg_cache_update(struct mt7601u_dev *dev, u32 offset, u32 val)
+{
+	mt7601u_reg_cache_wr(dev, offset, val, true);
+}
+
+u32 mt7601u_reg_cache_gen(struct mt7601u_dev *dev)
+{
+	u32 gen;
+
+	spin_lock_bh(&dev->reg_cache_lock);
+	gen = dev->reg_cache_gen;
+	spin_unlock_bh(&dev->reg_cache_lock);
+
+	return gen;
+}
+
+/* Fill the shadow with a value read from the device.  @gen has to be taken
+ * before the read was issued, if any write was reported since the value
+ * may be stale and is dropped.
+ */
+void mt7601u_reg_cache_fill(struct mt7601u_dev *dev, u32 offset, u32 val,
+			    u32 gen)
+{
+	int idx = mt7601u_reg_cache_idx(offset);
+
+	if (idx < 0)
+		return;
+
+	spin_lock_bh(&dev->reg_cache_lock);
+	if (gen == dev->reg_cache_gen) {
+		dev->reg_cache[idx] = val;
+		__set_bit(idx, dev->reg_cache_valid);
+	} else {
+		dev->reg_cache_stats.stale++;
+	}
+	spin_unlock_bh(&dev->reg_cache_lock);
+}
+
+/* Apply a masked update done by the MCU to the shadow, if it's valid */
+void mt7601u_reg_cache_rmw(struct mt7601u_dev *dev, u32 offset,
+			   u32 mask, u32 val)
+{
+	int idx = mt7601u_reg_cache_idx(offset);
+	bool reset = mt7601u_reg_cache_resets(offset, mask & val);
+
+	if (idx < 0 && !reset)
+		return;
+
+	spin_lock_bh(&dev->reg_cache_lock);
+	if (idx >= 0 && test_bit(idx, dev->reg_cache_valid))
+		dev->reg_cache[idx] = (dev->reg_cache[idx] & ~mask) | val;
+	dev->reg_cache_gen++;
+	if (reset)
+		__mt7601u_reg_cache_invalidate(dev);
+	spin_unlock_bh(&dev->reg_cache_lock);
+}
+
+/* Forget all shadow values, next access to each register will re-sync it */
+void mt7601u_reg_cache_invalidate(struct mt7601u_dev *dev)
+{
+	spin_lock_bh(&dev->reg_cache_lock);
+	__mt7601u_reg_cache_invalidate(dev);
+	spin_unlock_bh(&dev->reg_cache_lock);
 }
 
 u32 mt7601u_rr(struct mt7601u_dev *dev, u32 offset)
 {
-	int ret;
+	int ret, idx;
 	__le32 reg;
-	u32 val;
+	u32 val, gen = 0;
 
 	if (offset > 0xffff)
 		printk("Error: high offset read: %08x\n", offset);
 
+	idx = mt7601u_reg_cache_idx(offset);
+	if (idx >= 0 && mt7601u_reg_cache_get(dev, idx, &val, &gen))
+		goto out;
+
 	ret = mt7601u_vendor_request(dev, VEND_MULTI_READ, USB_DIR_IN,
 				     0, offset, &reg, sizeof(reg));
 	val = le32_to_cpu(reg);
@@ -143,12 +706,200 @@ u32 mt7601u_rr(struct mt7601u_dev *dev, u32 offset)
 		if (ret != -ENODEV)
 			printk("RR of %08x - wrong size  %d!!\n", offset, ret);
 		val = ~0;
+	} else if (idx >= 0) {
+		mt7601u_reg_cache_fill(dev, offset, val, gen);
 	}
-
+out:
 	trace_reg_read(dev, offset, val);
 	return val;
 }
 
+/* Read @n consecutive registers starting at @offset, using as few control
+ * transfers as possible.  On error @out is filled with all-ones.
+ */
+static int
+mt7601u_rr_bulk_vendor(struct mt7601u_dev *dev, u32 offset, u32 *out, int n)
+{
+	const int max_regs = MT_VEND_BUF / sizeof(__le32);
+	__le32 buf[MT_VEND_BUF / sizeof(__le32)];
+	int cnt, i, ret;
+	u32 gen;
+
+	while (n) {
+		cnt = min(n, max_regs);
+
+		gen = mt7601u_reg_cache_gen(dev);
+		ret = mt7601u_vendor_request(dev, VEND_MULTI_READ, USB_DIR_IN,
+					     0, offset, buf, cnt * 4);
+		if (ret != cnt * 4) {
+			if (ret != -ENODEV)
+				printk("RR bulk of %08x - wrong size %d!!\n",
+				       offset, ret);
+			memset(out, 0xff, n * sizeof(*out));
+			return ret < 0 ? ret : -EIO;
+		}
+
+		for (i = 0; i < cnt; i++) {
+			out[i] = le32_to_cpu(buf[i]);
+			trace_reg_read(dev, offset + i * 4, out[i]);
+			mt7601u_reg_cache_fill(dev, offset + i * 4, out[i],
+					       gen);
+		}
+
+		offset += cnt * 4;
+		out += cnt;
+		n -= cnt;
+	}
+
+	return 0;
+}
+
+int mt7601u_rr_bulk(struct mt7601u_dev *dev, u32 offset, u32 *out, int n)
+{
+	u16 burst_min = READ_ONCE(dev->rd_burst_min);
+
+	if (burst_min && n >= burst_min &&
+	    test_bit(MT7601U_STATE_MCU_RUNNING, &dev->state))
+		return mt7601u_burst_read_regs(dev, offset, out, n);
+
+	return mt7601u_rr_bulk_vendor(dev, offset, out, n);
+}
+
+/* Time reading @n registers of the WCID address table (not cached, not
+ * clear-on-read) with each available mechanism.  Results are used to move
+ * the threshold above which mt7601u_rr_bulk() switches to MCU burst reads.
+ */
+int mt7601u_rr_bench(struct mt7601u_dev *dev, int n)
+{
+	struct mt7601u_rd_bench *bench = &dev->rd_bench;
+	struct mt76_reg_pair *rp;
+	ktime_t start;
+	u32 *vals;
+	int i, ret;
+
+	if (n < 1 || n > MT_RD_BENCH_MAX)
+		return -EINVAL;
+	if (!test_bit(MT7601U_STATE_MCU_RUNNING, &dev->state))
+		return -EBUSY;
+
+	vals = kcalloc(n, sizeof(*vals), GFP_KERNEL);
+	rp = kcalloc(n, sizeof(*rp), GFP_KERNEL);
+	if (!vals || !rp) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	for (i = 0; i < n; i++)
+		rp[i].reg = MT_WCID_ADDR_BASE + i * 4;
+
+	start = ktime_get();
+	for (i = 0; i < n; i++)
+		vals[i] = mt7601u_rr(dev, MT_WCID_ADDR_BASE + i * 4);
+	bench->us[MT_RD_SINGLE] = ktime_us_delta(ktime_get(), start);
+
+	start = ktime_get();
+	ret = mt7601u_rr_bulk_vendor(dev, MT_WCID_ADDR_BASE, vals, n);
+	if (ret)
+		goto out;
+	bench->us[MT_RD_VEND_BULK] = ktime_us_delta(ktime_get(), start);
+
+	start = ktime_get();
+	ret = mt7601u_read_reg_pairs(dev, MT_MCU_MEMMAP_WLAN, rp, n);
+	if (ret)
+		goto out;
+	bench->us[MT_RD_MCU_RANDOM] = ktime_us_delta(ktime_get(), start);
+
+	start = ktime_get();
+	ret = mt7601u_burst_read_regs(dev, MT_WCID_ADDR_BASE, vals, n);
+	if (ret)
+		goto out;
+	bench->us[MT_RD_MCU_BURST] = ktime_us_delta(ktime_get(), start);
+
+	bench->n = n;
+
+	for (i = 0; i < n; i++)
+		if (vals[i] != rp[i].value)
+			dev_warn(dev->dev, "Warning: MCU read mismatch %04x: "
+				 "%08x != %08x\n", rp[i].reg, vals[i],
+				 rp[i].value);
+
+	if (bench->us[MT_RD_MCU_BURST] < bench->us[MT_RD_VEND_BULK]) {
+		if (!dev->rd_burst_min || dev->rd_burst_min > n)
+			WRITE_ONCE(dev->rd_burst_min, n);
+	} else if (dev->rd_burst_min && dev->rd_burst_min <= n) {
+		WRITE_ONCE(dev->rd_burst_min, n + 1);
+	}
+out:
+	kfree(rp);
+	kfree(vals);
+
+	return ret;
+}
+
+/* Time writing @n registers of the WCID address table with split 16-bit
+ * writes and with single-transfer multi-writes.  Values read beforehand are
+ * written back so the table is left intact.
+ */
+int mt7601u_wr_bench(struct mt7601u_dev *dev, int n)
+{
+	struct mt7601u_wr_bench *bench = &dev->wr_bench;
+	ktime_t start;
+	__le32 reg;
+	u32 *vals;
+	int i, ret;
+
+	if (n < 1 || n > MT_WR_BENCH_MAX)
+		return -EINVAL;
+	if (!test_bit(MT7601U_STATE_INITIALIZED, &dev->state))
+		return -EBUSY;
+
+	vals = kcalloc(n, sizeof(*vals), GFP_KERNEL);
+	if (!vals)
+		return -ENOMEM;
+
+	ret = mt7601u_rr_bulk_vendor(dev, MT_WCID_ADDR_BASE, vals, n);
+	if (ret)
+		goto out;
+
+	start = ktime_get();
+	for (i = 0; i < n; i++) {
+		ret = mt7601u_vendor_single_wr(dev, VEND_WRITE,
+					       MT_WCID_ADDR_BASE + i * 4,
+					       vals[i]);
+		if (ret)
+			goto out;
+	}
+	bench->us[MT_WR_SPLIT] = ktime_us_delta(ktime_get(), start);
+	bench->xfers[MT_WR_SPLIT] = 2 * n;
+
+	/* Hardware which failed the probe can't do it */
+	bench->us[MT_WR_MULTI] = 0;
+	bench->xfers[MT_WR_MULTI] = 0;
+	if (dev->vend_multi_wr) {
+		start = ktime_get();
+		for (i = 0; i < n; i++) {
+			reg = cpu_to_le32(vals[i]);
+			ret = mt7601u_vendor_request(dev, VEND_MULTI_WRITE,
+						     USB_DIR_OUT, 0,
+						     MT_WCID_ADDR_BASE + i * 4,
+						     &reg, sizeof(reg));
+			if (ret != sizeof(reg)) {
+				ret = ret < 0 ? ret : -EIO;
+				goto out;
+			}
+		}
+		bench->us[MT_WR_MULTI] = ktime_us_delta(ktime_get(), start);
+		bench->xfers[MT_WR_MULTI] = n;
+	}
+
+	bench->n = n;
+	ret = 0;
+out:
+	kfree(vals);
+
+	return ret;
+}
+
 int mt7601u_vendor_single_wr(struct mt7601u_dev *dev, const u8 req,
 			     const u16 offset, const u32 val)
 {
@@ -161,19 +912,188 @@ int mt7601u_vendor_single_wr(struct mt7601u_dev *dev, const u8 req,
 				      val >> 16, offset + 2, NULL, 0);
 }
 
-void mt7601u_wr(struct mt7601u_dev *dev, u32 offset, u32 val)
+static void __mt7601u_wr(struct mt7601u_dev *dev, u32 offset, u32 val)
 {
+	int ret;
+
 	if (offset > 0xffff)
 		printk("Error: high offset write: %08x\n", offset);
 
-	mt7601u_vendor_single_wr(dev, VEND_WRITE, offset, val);
+	if (dev->vend_multi_wr) {
+		__le32 reg = cpu_to_le32(val);
+
+		ret = mt7601u_vendor_request(dev, VEND_MULTI_WRITE, USB_DIR_OUT,
+					     0, offset, &reg, sizeof(reg));
+		ret = ret == sizeof(reg) ? 0 : -EIO;
+	} else {
+		ret = mt7601u_vendor_single_wr(dev, VEND_WRITE, offset, val);
+	}
+	dev->vend_wrs++;
+	trace_reg_write(dev, offset, val);
+
+	mt7601u_reg_cache_wr(dev, offset, val, !ret);
+}
+
+static void mt7601u_wr_batch_add(struct mt7601u_dev *dev, u32 offset, u32 val)
+{
+	struct mt7601u_wr_batch *b = &dev->wr_batch;
+
+	if (b->n == ARRAY_SIZE(b->regs))
+		mt7601u_wr_batch_flush(dev);
+
+	b->regs[b->n].reg = offset;
+	b->regs[b->n].value = val;
+	b->n++;
+
 	trace_reg_write(dev, offset, val);
+	mt7601u_reg_cache_update(dev, offset, val);
+}
+
+void mt7601u_wr(struct mt7601u_dev *dev, u32 offset, u32 val)
+{
+	if (mt7601u_wr_batch_owner(dev))
+		mt7601u_wr_batch_add(dev, offset, val);
+	else
+		__mt7601u_wr(dev, offset, val);
+}
+
+/* Start recording register writes done by current task, they will be sent
+ * out in as few MCU CMD_RANDOM_WRITE packets as possible on commit (or when
+ * current task needs to access the device in any other way).  Batches
+ * don't nest, if another batch is open writes are done directly.
+ */
+void mt7601u_wr_batch_begin(struct mt7601u_dev *dev)
+{
+	struct mt7601u_wr_batch *b = &dev->wr_batch;
+
+	if (cmpxchg(&b->owner, NULL, current))
+		return;
+
+	b->caller = _RET_IP_;
+	b->writes = 0;
+	b->packets = 0;
+}
+
+/* Note: must only be called by the batch owner */
+void mt7601u_wr_batch_flush(struct mt7601u_dev *dev)
+{
+	struct mt7601u_wr_batch *b = &dev->wr_batch;
+	int i, n = b->n, ret = -EIO;
+
+	if (!n)
+		return;
+	b->n = 0;
+	b->writes += n;
+
+	if (test_bit(MT7601U_STATE_MCU_RUNNING, &dev->state)) {
+		ret = mt7601u_write_reg_pairs(dev, MT_MCU_MEMMAP_WLAN,
+					      b->regs, n);
+		if (!ret)
+			b->packets += DIV_ROUND_UP(n,
+						   INBAND_PACKET_MAX_LEN / 8);
+	}
+
+	/* Before firmware is loaded (or if MCU failed) use control xfers */
+	if (ret) {
+		for (i = 0; i < n; i++)
+			__mt7601u_wr(dev, b->regs[i].reg, b->regs[i].value);
+		b->packets += dev->vend_multi_wr ? n : 2 * n;
+	}
+}
+
+void mt7601u_wr_batch_commit(struct mt7601u_dev *dev)
+{
+	struct mt7601u_wr_batch *b = &dev->wr_batch;
+	struct mt7601u_wr_batch_stat *st = NULL;
+	int i;
+
+	if (!mt7601u_wr_batch_owner(dev))
+		return;
+
+	mt7601u_wr_batch_flush(dev);
+
+	for (i = 0; i < ARRAY_SIZE(dev->wr_batch_stats); i++)
+		if (dev->wr_batch_stats[i].caller == b->caller ||
+		    !dev->wr_batch_stats[i].caller) {
+			st = &dev->wr_batch_stats[i];
+			break;
+		}
+
+	if (st) {
+		st->caller = b->caller;
+		st->commits++;
+		st->writes += b->writes;
+		st->xfers += b->packets;
+	}
+
+	WRITE_ONCE(b->owner, NULL);
+}
+
+/* Queue a register write without waiting for it to complete.  Any
+ * synchronous register access or MCU command flushes posted writes first.
+ * Note: inside a write batch the write is recorded in the batch instead,
+ *	 i.e. it goes out synchronously with the rest of the batch.
+ */
+void mt7601u_wr_posted(struct mt7601u_dev *dev, u32 offset, u32 val)
+{
+	__le32 reg = cpu_to_le32(val);
+	int ret;
+
+	if (test_bit(MT7601U_STATE_REMOVED, &dev->state))
+		return;
+
+	if (mt7601u_wr_batch_owner(dev)) {
+		mt7601u_wr_batch_add(dev, offset, val);
+		return;
+	}
+
+	mt7601u_mcu_wait_idle(dev);
+
+	mt7601u_vendor_lock(dev);
+	if (dev->vend_multi_wr) {
+		ret = mt7601u_vendor_post(dev, VEND_MULTI_WRITE, 0, offset,
+					  &reg, sizeof(reg));
+	} else {
+		ret = mt7601u_vendor_post(dev, VEND_WRITE, val & 0xffff,
+					  offset, NULL, 0);
+		if (!ret)
+			ret = mt7601u_vendor_post(dev, VEND_WRITE, val >> 16,
+						  offset + 2, NULL, 0);
+	}
+	mt7601u_vendor_unlock(dev);
+
+	if (ret) {
+		mt7601u_wr(dev, offset, val);
+		return;
+	}
+
+	dev->vend_wrs++;
+	trace_reg_write(dev, offset, val);
+	mt7601u_reg_cache_update(dev, offset, val);
+}
+
+/* Skip writing a value which the shadow says is already in the register */
+static bool mt7601u_reg_cache_skip(struct mt7601u_dev *dev, u32 offset,
+				   u32 old, u32 val)
+{
+	if (old != val || !dev->reg_cache_en ||
+	    mt7601u_reg_cache_idx(offset) < 0)
+		return false;
+
+	spin_lock_bh(&dev->reg_cache_lock);
+	dev->reg_cache_stats.skipped++;
+	spin_unlock_bh(&dev->reg_cache_lock);
+
+	return true;
 }
 
 u32 mt7601u_rmw(struct mt7601u_dev *dev, u32 offset, u32 mask, u32 val)
 {
-	val |= mt7601u_rr(dev, offset) & ~mask;
-	mt7601u_wr(dev, offset, val);
+	u32 reg = mt7601u_rr(dev, offset);
+
+	val |= reg & ~mask;
+	if (!mt7601u_reg_cache_skip(dev, offset, reg, val))
+		mt7601u_wr(dev, offset, val);
 	return val;
 }
 
@@ -186,6 +1106,79 @@ u32 mt7601u_rmc(struct mt7601u_dev *dev, u32 offset, u32 mask, u32 val)
 	return val;
 }
 
+/* Masked update of MAC, BBP (MT_MCU_MEMMAP_BBP) or RF (MT_MCU_MEMMAP_RF)
+ * register done by the MCU, saves the read round trip when the caller
+ * doesn't need the new value.  Returns -EBUSY if the MCU can't be used,
+ * callers should then fall back to the host-side rmw.
+ */
+int mt7601u_mcu_rmw(struct mt7601u_dev *dev, u32 base, u32 offset,
+		    u32 mask, u32 val)
+{
+	struct mt76_reg_rmw rmw = { offset, mask, val };
+
+	if (!dev->mcu_rmw ||
+	    !test_bit(MT7601U_STATE_MCU_RUNNING, &dev->state))
+		return -EBUSY;
+
+	/* MCU commands don't act as barriers for earlier writes */
+	if (mt7601u_wr_batch_owner(dev))
+		mt7601u_wr_batch_flush(dev);
+	mt7601u_vendor_flush(dev);
+
+	return mt7601u_mcu_rmw_regs(dev, base, &rmw, 1);
+}
+
+void mt7601u_rmw_mcu(struct mt7601u_dev *dev, u32 offset, u32 mask, u32 val)
+{
+	/* Shadowed registers are cheaper to update from the host */
+	if (mt7601u_reg_cache_idx(offset) >= 0 ||
+	    mt7601u_mcu_rmw(dev, MT_MCU_MEMMAP_WLAN, offset, mask, val))
+		mt7601u_rmw(dev, offset, mask, val);
+}
+
+/* Check if 32-bit writes can be done in one control transfer with a data
+ * stage, if not (or if the readback doesn't match) fall back to writing
+ * the register in two 16-bit halves.
+ */
+static void mt7601u_vendor_probe_multi_wr(struct mt7601u_dev *dev)
+{
+	const u32 test = 0x5aa5c33c;
+	__le32 old, reg = cpu_to_le32(test);
+	int ret;
+
+	/* Note: go around the register cache, MAC_ADDR is cacheable.
+	 *	 Original value is put back below, nothing relies on init
+	 *	 rewriting it.
+	 */
+	ret = mt7601u_vendor_request(dev, VEND_MULTI_READ, USB_DIR_IN,
+				     0, MT_MAC_ADDR_DW0, &old, sizeof(old));
+	if (ret != sizeof(old)) {
+		dev->vend_multi_wr = false;
+		return;
+	}
+
+	ret = mt7601u_vendor_request(dev, VEND_MULTI_WRITE, USB_DIR_OUT,
+				     0, MT_MAC_ADDR_DW0, &reg, sizeof(reg));
+	if (ret != sizeof(reg))
+		goto split;
+
+	ret = mt7601u_vendor_request(dev, VEND_MULTI_READ, USB_DIR_IN,
+				     0, MT_MAC_ADDR_DW0, &reg, sizeof(reg));
+	if (ret != sizeof(reg) || le32_to_cpu(reg) != test)
+		goto split;
+
+	dev->vend_multi_wr = true;
+	ret = mt7601u_vendor_request(dev, VEND_MULTI_WRITE, USB_DIR_OUT,
+				     0, MT_MAC_ADDR_DW0, &old, sizeof(old));
+	if (ret == sizeof(old))
+		return;
+split:
+	dev_info(dev->dev, "Using split 16-bit register writes\n");
+	dev->vend_multi_wr = false;
+	mt7601u_vendor_single_wr(dev, VEND_WRITE, MT_MAC_ADDR_DW0,
+				 le32_to_cpu(old));
+}
+
 void mt7601u_wr_copy(struct mt7601u_dev *dev, u32 offset,
 		     const void *data, int len)
 {
@@ -238,11 +1231,45 @@ static int mt7601u_assign_pipes(struct usb_interface *usb_intf,
 	return 0;
 }
 
+/* Second stage of probe, mac80211 is already registered at this point but
+ * mt7601u_start() will wait for us.
+ */
+static void mt7601u_init_work(struct work_struct *work)
+{
+	struct mt7601u_dev *dev = container_of(work, struct mt7601u_dev,
+					       init_work);
+	u64 xfers = dev->vend_reqs, wrs = dev->vend_wrs;
+	ktime_t start = ktime_get();
+	int ret;
+
+	ret = mt7601u_init_hardware(dev);
+	if (ret) {
+		dev_err(dev->dev, "Error: HW init failed: %d\n", ret);
+		goto out;
+	}
+
+	dev->mcu.stats.init_buf_gets = dev->mcu.stats.buf_gets;
+	dev->wr_bench.init_us = ktime_us_delta(ktime_get(), start);
+	dev->wr_bench.init_xfers = dev->vend_reqs - xfers;
+	dev->wr_bench.init_wrs = dev->vend_wrs - wrs;
+	set_bit(MT7601U_STATE_INITIALIZED, &dev->state);
+
+	dev_dbg(dev->dev,
+		"HW init: %uus, %llu control transfers, %llu reg writes\n",
+		dev->wr_bench.init_us, dev->wr_bench.init_xfers,
+		dev->wr_bench.init_wrs);
+out:
+	dev->init_ret = ret;
+	complete_all(&dev->init_done);
+}
+
 static int mt7601u_probe(struct usb_interface *usb_intf,
 			 const struct usb_device_id *id)
 {
 	struct usb_device *usb_dev = interface_to_usbdev(usb_intf);
 	struct mt7601u_dev *dev;
+	ktime_t start = ktime_get();
+	u64 xfers;
 	int ret;
 
 	dev = mt7601u_alloc_device(&usb_intf->dev);
@@ -271,19 +1298,27 @@ static int mt7601u_probe(struct usb_interface *usb_intf,
 	if (!(mt7601u_rr(dev, MT_EFUSE_CTRL) & MT_EFUSE_CTRL_SEL))
 		printk("Error: eFUSE not present\n");
 
-	ret = mt7601u_init_hardware(dev);
+	mt7601u_vendor_probe_multi_wr(dev);
+
+	xfers = dev->vend_reqs;
+	ret = mt7601u_init_early(dev);
 	if (ret)
 		goto err;
 
 	ret = mt7601u_register_device(dev);
 	if (ret)
-		goto err_hw;
+		goto err;
 
-	set_bit(MT7601U_STATE_INITIALIZED, &dev->state);
+	dev_dbg(dev->dev, "Probe: %lldus, %llu control transfers\n",
+		ktime_us_delta(ktime_get(), start), dev->vend_reqs - xfers);
+
+	/* Firmware, MAC/BBP init and calibration take seconds, don't hold up
+	 * enumeration of other devices for that long
+	 */
+	INIT_WORK(&dev->init_work, mt7601u_init_work);
+	queue_work(system_long_wq, &dev->init_work);
 
 	return 0;
-err_hw:
-	mt7601u_cleanup(dev);
 err:
 	usb_set_intfdata(usb_intf, NULL);
 	usb_put_dev(interface_to_usbdev(usb_intf));
@@ -298,7 +1333,10 @@ static void mt7601u_disconnect(struct usb_interface *usb_intf)
 	struct mt7601u_dev *dev = usb_get_intfdata(usb_intf);
 
 	ieee80211_unregister_hw(dev->hw);
-	mt7601u_cleanup(dev);
+	/* Second stage of probe may still be running */
+	flush_work(&dev->init_work);
+	if (test_bit(MT7601U_STATE_INITIALIZED, &dev->state))
+		mt7601u_cleanup(dev);
 
 	usb_set_intfdata(usb_intf, NULL);
 	usb_put_dev(interface_to_usbdev(usb_intf));
@@ -18,9 +18,15 @@
 
 #define VEND_DEV_MODE_RESET		1
 
+/* Size of the DMA-able bounce buffer for control transfer data stage,
+ * also the max length of a single multi-register read.
+ */
+#define MT_VEND_BUF			64
+
 enum mt_vendor_req {
 	VEND_DEV_MODE = 1,
 	VEND_WRITE = 2,
+	VEND_MULTI_WRITE = 6,
 	VEND_MULTI_READ = 7,
 	VEND_WRITE_FCE = 0x42,
 };